@@ -0,0 +1,792 @@
+/* bench.c : host-native microbenchmarks for kernel data structures
+
+Called from outside:
+  bench_start() - program entry point, runs every benchmark and exits
+
+Note:
+  Each benchmark is run BENCH_REPEATS times, from a freshly initialized heap
+  and pcb table, with the same random seed. Results are printed to stdout as
+  CSV, one row per benchmark, in cycles per operation as measured by rdtsc.
+  A second table gives message passing throughput, for message sizes from
+  4 bytes to 64 KB.
+  Cycle counts are kept in 32 bits, so a single timed section must stay well
+  under a second.
+  Rows marked emulated in the source column do not run the kernel's own
+  trap path. yield_alone and timer_int_alone repeat the dispatcher's
+  decisions around the ctsw fast path, but no ctsw, and the signal storms
+  emulate the trap back in through syssigreturn. Every other row runs
+  the kernel's code directly.
+  A third table gives the signal storms, which time the kernel's side of
+  delivering a burst of signals, and count the traps each storm takes.
+  Single delivery costs one per signal, batched delivery through
+  sigtramp_batch one per burst. sigqueue_sigwait takes the signals
+  synchronously instead, with no handler frame or trap back.
+  Run with make bench BUILD=release to time an optimised build without
+  invariant checks; ready_queue_churn shows what the checks cost a switch.
+
+Further details can be found in the documentation above the function headers.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <pcb.h>
+#include <i386.h>
+
+#define BENCH_REPEATS 5
+#define BENCH_SEED 415
+
+#define BENCH_MAX_SLEEPERS 1000
+
+typedef struct bench {
+    char *name;
+    /* runs the benchmark, returns cycles spent in its timed section */
+    unsigned long (*run)(int param, int *ops);
+    int param;
+    /* 1 if the benchmark emulates a trap path, rather than running it */
+    int emulated;
+} bench_t;
+
+extern long freemem;
+extern char *maxaddr;
+extern proc_ctrl_block_t g_pcb_table[PCB_CHUNK_SIZE];
+
+void bench_start(void);
+void bench_exit(int status);
+
+/* the delta list sleep.c replaced, see deltalist.c */
+void delta_init(void);
+void delta_sleep(proc_ctrl_block_t *proc, unsigned int time);
+void delta_wake(proc_ctrl_block_t *proc);
+void delta_tick(void);
+int delta_list_empty(void);
+
+typedef struct sleep_impl {
+    void (*sleep)(proc_ctrl_block_t *proc, unsigned int time);
+    void (*wake)(proc_ctrl_block_t *proc);
+    void (*tick)(void);
+    int (*empty)(void);
+} sleep_impl_t;
+
+static void bench_reset(void);
+static void run_bench(bench_t *bench);
+static void run_throughput_bench(bench_t *bench);
+static void run_storm_bench(bench_t *bench);
+static proc_ctrl_block_t* create_bench_proc(void);
+static void dummy(void);
+
+static unsigned long bench_kmalloc_mix(int live_slots, int *ops);
+static unsigned long bench_kslab(int size, int *ops);
+static unsigned long bench_create_cleanup(int holes, int *ops);
+static void fragment_heap(int holes);
+static unsigned long bench_ready_queue(int num_procs, int *ops);
+static unsigned long bench_pid_lookup(int num_procs, int *ops);
+static unsigned long bench_yield_alone(int fast, int *ops);
+static unsigned long bench_timer_alone(int fast, int *ops);
+static unsigned long bench_wheel_insert(int num_sleepers, int *ops);
+static unsigned long bench_wheel_tick(int num_sleepers, int *ops);
+static unsigned long bench_wheel_cancel(int num_sleepers, int *ops);
+static unsigned long bench_delta_insert(int num_sleepers, int *ops);
+static unsigned long bench_delta_tick(int num_sleepers, int *ops);
+static unsigned long bench_delta_cancel(int num_sleepers, int *ops);
+static unsigned long bench_sleep_insert(sleep_impl_t *impl, int num_sleepers,
+                                        proc_ctrl_block_t **procs);
+static unsigned long bench_sleep_tick(sleep_impl_t *impl, int num_sleepers,
+                                      int *ops);
+static unsigned long bench_sleep_cancel(sleep_impl_t *impl, int num_sleepers,
+                                        int *ops);
+static int wheel_empty(void);
+static unsigned long bench_send_recv(int len, int *ops);
+static unsigned long bench_mbox(int len, int *ops);
+static unsigned long bench_signal_storm_single(int num_signals, int *ops);
+static unsigned long bench_signal_storm_batch(int num_signals, int *ops);
+static unsigned long bench_signal_storm(int batch, int num_signals, int *ops);
+static void storm_handler(void *cntx);
+static unsigned long bench_sigqueue_sigwait(int num_signals, int *ops);
+
+static bench_t g_benches[] = {
+    { "kmalloc_kfree_mix",  &bench_kmalloc_mix,  16 },
+    { "kmalloc_kfree_mix",  &bench_kmalloc_mix,  64 },
+    { "kmalloc_kfree_mix",  &bench_kmalloc_mix,  256 },
+    { "kslab_alloc_free",   &bench_kslab,        128 },
+    { "create_cleanup",     &bench_create_cleanup, 0 },
+    { "create_cleanup",     &bench_create_cleanup, 256 },
+    { "ready_queue_churn",  &bench_ready_queue,  1 },
+    { "ready_queue_churn",  &bench_ready_queue,  8 },
+    { "ready_queue_churn",  &bench_ready_queue,  PCB_CHUNK_SIZE },
+    { "ready_queue_churn",  &bench_ready_queue,  8 * PCB_CHUNK_SIZE },
+    { "pid_lookup",         &bench_pid_lookup,   PCB_CHUNK_SIZE },
+    { "pid_lookup",         &bench_pid_lookup,   8 * PCB_CHUNK_SIZE },
+    { "yield_alone",        &bench_yield_alone,  0, 1 },
+    { "yield_alone",        &bench_yield_alone,  1, 1 },
+    { "timer_int_alone",    &bench_timer_alone,  0, 1 },
+    { "timer_int_alone",    &bench_timer_alone,  1, 1 },
+    { "delta_list_insert",  &bench_delta_insert, 1 },
+    { "delta_list_insert",  &bench_delta_insert, 10 },
+    { "delta_list_insert",  &bench_delta_insert, 100 },
+    { "delta_list_insert",  &bench_delta_insert, BENCH_MAX_SLEEPERS },
+    { "timer_wheel_insert", &bench_wheel_insert, 1 },
+    { "timer_wheel_insert", &bench_wheel_insert, 10 },
+    { "timer_wheel_insert", &bench_wheel_insert, 100 },
+    { "timer_wheel_insert", &bench_wheel_insert, BENCH_MAX_SLEEPERS },
+    { "delta_list_tick",    &bench_delta_tick,   1 },
+    { "delta_list_tick",    &bench_delta_tick,   10 },
+    { "delta_list_tick",    &bench_delta_tick,   100 },
+    { "delta_list_tick",    &bench_delta_tick,   BENCH_MAX_SLEEPERS },
+    { "timer_wheel_tick",   &bench_wheel_tick,   1 },
+    { "timer_wheel_tick",   &bench_wheel_tick,   10 },
+    { "timer_wheel_tick",   &bench_wheel_tick,   100 },
+    { "timer_wheel_tick",   &bench_wheel_tick,   BENCH_MAX_SLEEPERS },
+    { "delta_list_cancel",  &bench_delta_cancel, 100 },
+    { "delta_list_cancel",  &bench_delta_cancel, BENCH_MAX_SLEEPERS },
+    { "timer_wheel_cancel", &bench_wheel_cancel, 100 },
+    { "timer_wheel_cancel", &bench_wheel_cancel, BENCH_MAX_SLEEPERS },
+    { "send_recv_pair",     &bench_send_recv,    4 },
+    { "send_recv_pair",     &bench_send_recv,    64 },
+    { "send_recv_pair",     &bench_send_recv,    1024 },
+    { "mbox_post_recv",     &bench_mbox,         4 },
+    { "mbox_post_recv",     &bench_mbox,         MBOX_MSG_SIZE },
+    { "sigqueue_sigwait",   &bench_sigqueue_sigwait, 1 },
+    { "sigqueue_sigwait",   &bench_sigqueue_sigwait, SIGNAL_QUEUE_SIZE },
+};
+
+// param is the number of signals fired per storm
+static bench_t g_storm_benches[] = {
+    { "signal_storm_single", &bench_signal_storm_single, 1, 1 },
+    { "signal_storm_single", &bench_signal_storm_single, 8, 1 },
+    { "signal_storm_single", &bench_signal_storm_single, SIGNAL_TABLE_SIZE, 1 },
+    { "signal_storm_batch", &bench_signal_storm_batch, 1, 1 },
+    { "signal_storm_batch", &bench_signal_storm_batch, 8, 1 },
+    { "signal_storm_batch", &bench_signal_storm_batch, SIGNAL_TABLE_SIZE, 1 },
+};
+
+// traps back in through syssigreturn during the last signal storm
+static int g_storm_traps;
+
+// the sleep devices compared by the sleep benchmarks
+static sleep_impl_t g_wheel_impl = { &sleep, &wake, &tick, &wheel_empty };
+static sleep_impl_t g_delta_impl =
+    { &delta_sleep, &delta_wake, &delta_tick, &delta_list_empty };
+
+// param is the number of bytes moved per operation
+static bench_t g_throughput_benches[] = {
+    { "send_recv_pair",     &bench_send_recv,    4 },
+    { "send_recv_pair",     &bench_send_recv,    64 },
+    { "send_recv_pair",     &bench_send_recv,    1024 },
+    { "send_recv_pair",     &bench_send_recv,    4096 },
+    { "send_recv_pair",     &bench_send_recv,    16384 },
+    { "send_recv_pair",     &bench_send_recv,    65536 },
+};
+
+/**
+ * Program entry point. Runs every benchmark, then exits.
+ */
+void bench_start(void) {
+#if defined(KMEM_POLICY_TLSF)
+    kprintf("# kmem policy: TLSF\n");
+#else
+    kprintf("# kmem policy: FIRST_FIT\n");
+#endif
+    kprintf("# check level: %d\n", CHECK_LEVEL);
+    kprintf("benchmark,param,ops,min_cycles_per_op,avg_cycles_per_op,"
+            "source\n");
+
+    for (int i = 0; i < sizeof(g_benches) / sizeof(bench_t); i++) {
+        run_bench(&g_benches[i]);
+    }
+
+    kprintf("\nbenchmark,bytes,ops,min_cycles_per_op,bytes_per_kcycle\n");
+    for (int i = 0; i < sizeof(g_throughput_benches) / sizeof(bench_t); i++) {
+        run_throughput_bench(&g_throughput_benches[i]);
+    }
+
+    kprintf("\nbenchmark,signals,storms,traps_per_storm,min_cycles_per_storm,"
+            "source\n");
+    for (int i = 0; i < sizeof(g_storm_benches) / sizeof(bench_t); i++) {
+        run_storm_bench(&g_storm_benches[i]);
+    }
+
+    bench_exit(0);
+}
+
+/**
+ * Runs a benchmark BENCH_REPEATS times, and prints its CSV row
+ * @param bench - the benchmark to run
+ */
+static void run_bench(bench_t *bench) {
+    unsigned long cycles, min_cycles = -1, total_cycles = 0;
+    int ops = 0;
+
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        bench_reset();
+        cycles = bench->run(bench->param, &ops);
+        min_cycles = MIN(min_cycles, cycles);
+        total_cycles += cycles;
+    }
+
+    kprintf("%s,%d,%d,%d,%d,%s\n", bench->name, bench->param, ops,
+            min_cycles / ops, total_cycles / BENCH_REPEATS / ops,
+            bench->emulated ? "emulated" : "kernel");
+}
+
+/**
+ * Runs a benchmark BENCH_REPEATS times, and prints its throughput CSV row
+ * @param bench - the benchmark to run, param being bytes per operation
+ */
+static void run_throughput_bench(bench_t *bench) {
+    unsigned long cycles, min_cycles = -1;
+    int ops = 0;
+
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        bench_reset();
+        cycles = bench->run(bench->param, &ops);
+        min_cycles = MIN(min_cycles, cycles);
+    }
+
+    unsigned long bytes_per_kcycle =
+        bench->param * 1000UL / MAX(min_cycles / ops, 1);
+
+    kprintf("%s,%d,%d,%d,%d\n", bench->name, bench->param, ops,
+            min_cycles / ops, bytes_per_kcycle);
+}
+
+/**
+ * Runs a signal storm benchmark BENCH_REPEATS times, and prints its CSV row
+ * with the traps each storm took
+ * @param bench - the benchmark to run, param being signals per storm
+ */
+static void run_storm_bench(bench_t *bench) {
+    unsigned long cycles, min_cycles = -1;
+    int ops = 0;
+
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        bench_reset();
+        cycles = bench->run(bench->param, &ops);
+        min_cycles = MIN(min_cycles, cycles);
+    }
+
+    int storms = ops / bench->param;
+    kprintf("%s,%d,%d,%d,%d,%s\n", bench->name, bench->param, storms,
+            g_storm_traps / storms, min_cycles / storms,
+            bench->emulated ? "emulated" : "kernel");
+}
+
+/**
+ * Puts the kernel's data structures back into their state after boot
+ */
+static void bench_reset(void) {
+    freemem = (long)bench_arena + KERNEL_STACK;
+    maxaddr = bench_arena + BENCH_ARENA_SIZE - 1;
+    memregions[0].mr_start = (unsigned long)bench_arena;
+    memregions[0].mr_end = (unsigned long)bench_arena + BENCH_ARENA_SIZE;
+    nmemregions = 1;
+
+    kmeminit();
+    kslab_init();
+    stackpool_init();
+    sleep_init();
+    delta_init();
+
+    // pcb_table_init expects the table as the loader left it, zeroed
+    memset(g_pcb_table, 0, sizeof(g_pcb_table));
+    pcb_table_init();
+
+    srand(BENCH_SEED);
+}
+
+/**
+ * kmalloc/kfree churn over live_slots slots, mixing stacks and small objects
+ * @param live_slots - number of allocations that may be live at once
+ * @param[out] ops - number of kmalloc and kfree calls made
+ * @return cycles spent
+ */
+static unsigned long bench_kmalloc_mix(int live_slots, int *ops) {
+    void *slots[256] = {0};
+    size_t size;
+    int i;
+
+    ASSERT(live_slots <= 256);
+    *ops = 20000;
+
+    unsigned long long start = rdtsc();
+    for (int round = 0; round < *ops; round++) {
+        i = rand() % live_slots;
+        if (slots[i] != NULL) {
+            kfree(slots[i]);
+            slots[i] = NULL;
+            continue;
+        }
+
+        // 1 in 4 allocations is a process stack, the rest are small objects
+        if (rand() % 4 == 0) {
+            size = DEFAULT_STACK_SIZE;
+        } else {
+            size = 16 + rand() % 512;
+        }
+
+        slots[i] = kmalloc(size);
+        ASSERT(slots[i] != NULL);
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * kslab_alloc/kslab_free of a batch of objects, repeatedly
+ * @param size - object size
+ * @param[out] ops - number of kslab_alloc and kslab_free calls made
+ * @return cycles spent
+ */
+static unsigned long bench_kslab(int size, int *ops) {
+    void *objs[100];
+    *ops = 0;
+
+    unsigned long long start = rdtsc();
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 100; i++) {
+            objs[i] = kslab_alloc(size);
+        }
+        for (int i = 0; i < 100; i++) {
+            kslab_free(objs[i]);
+        }
+        *ops += 200;
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Leaves holes small free blocks at the front of the heap,
+ * which a first fit search for a stack has to walk past
+ * @param holes - number of free blocks to leave
+ */
+static void fragment_heap(int holes) {
+    for (int i = 0; i < holes; i++) {
+        void *hole = kmalloc(32);
+        ASSERT(hole != NULL);
+        ASSERT(kmalloc(32) != NULL);
+        kfree(hole);
+    }
+}
+
+/**
+ * Creates and cleans up a process, as a shell command does, while small
+ * objects with longer lifetimes are allocated in between
+ * @param holes - number of free blocks left at the front of the heap
+ * @param[out] ops - number of processes created and cleaned up
+ * @return cycles spent
+ */
+static unsigned long bench_create_cleanup(int holes, int *ops) {
+    void *objs[16] = {0};
+
+    fragment_heap(holes);
+    *ops = 10000;
+
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        proc_ctrl_block_t *proc = create_bench_proc();
+
+        // first fit carves this out of the last freed stack,
+        // unless the stack went back to the pool instead
+        if (objs[i % 16] != NULL) {
+            kfree(objs[i % 16]);
+        }
+        objs[i % 16] = kmalloc(64);
+
+        remove_pcb_from_queue(proc);
+        cleanup_proc(proc);
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Round robins through num_procs ready processes, as the timer interrupt does
+ * @param num_procs - number of ready processes
+ * @param[out] ops - number of processes switched to
+ * @return cycles spent
+ */
+static unsigned long bench_ready_queue(int num_procs, int *ops) {
+    for (int i = 0; i < num_procs; i++) {
+        create_bench_proc();
+    }
+
+    proc_ctrl_block_t *proc = get_next_proc();
+    *ops = 10000;
+
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        add_pcb_to_queue(proc, PROC_STATE_READY);
+        proc = get_next_proc();
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Looks up random live pids, with the pcb table grown to hold num_procs
+ * @param num_procs - number of live processes, at most 8 * PCB_CHUNK_SIZE
+ * @param[out] ops - number of lookups made
+ * @return cycles spent
+ */
+static unsigned long bench_pid_lookup(int num_procs, int *ops) {
+    int pids[8 * PCB_CHUNK_SIZE];
+
+    for (int i = 0; i < num_procs; i++) {
+        pids[i] = create_bench_proc()->pid;
+    }
+
+    *ops = 10000;
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        ASSERT(pid_to_proc(pids[rand() % num_procs]) != NULL);
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * A lone process yields, as the dispatcher handles SYSCALL_YIELD
+ * @param fast - 0 to always go through the ready queue, as before the fast
+ *               path, 1 to skip it when nothing else would run
+ * @param[out] ops - number of yields
+ * @return cycles spent
+ */
+static unsigned long bench_yield_alone(int fast, int *ops) {
+    create_bench_proc();
+    proc_ctrl_block_t *proc = get_next_proc();
+    *ops = 10000;
+
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        if (!fast || ready_proc_waiting(proc)) {
+            add_pcb_to_queue(proc, PROC_STATE_READY);
+            proc = get_next_proc();
+        }
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * A lone process is interrupted by the timer, as timer_handler handles it
+ * @param fast - 0 to always go through the ready queue, as before the fast
+ *               path, 1 to keep running when nothing else would run
+ * @param[out] ops - number of ticks
+ * @return cycles spent
+ */
+static unsigned long bench_timer_alone(int fast, int *ops) {
+    create_bench_proc();
+    proc_ctrl_block_t *proc = get_next_proc();
+    *ops = 10000;
+
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        charge_proc_tick(proc);
+        tick();
+
+        if (!fast || quantum_expired(proc)) {
+            add_pcb_to_queue(proc, PROC_STATE_READY);
+            proc = get_next_proc();
+        }
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/*
+ * The sleep benchmarks below, run against the timer wheel in c/sleep.c,
+ * and against the delta list it replaced
+ */
+static unsigned long bench_wheel_insert(int num_sleepers, int *ops) {
+    proc_ctrl_block_t *procs[BENCH_MAX_SLEEPERS];
+    *ops = num_sleepers;
+    return bench_sleep_insert(&g_wheel_impl, num_sleepers, procs);
+}
+
+static unsigned long bench_wheel_tick(int num_sleepers, int *ops) {
+    return bench_sleep_tick(&g_wheel_impl, num_sleepers, ops);
+}
+
+static unsigned long bench_wheel_cancel(int num_sleepers, int *ops) {
+    return bench_sleep_cancel(&g_wheel_impl, num_sleepers, ops);
+}
+
+static unsigned long bench_delta_insert(int num_sleepers, int *ops) {
+    proc_ctrl_block_t *procs[BENCH_MAX_SLEEPERS];
+    *ops = num_sleepers;
+    return bench_sleep_insert(&g_delta_impl, num_sleepers, procs);
+}
+
+static unsigned long bench_delta_tick(int num_sleepers, int *ops) {
+    return bench_sleep_tick(&g_delta_impl, num_sleepers, ops);
+}
+
+static unsigned long bench_delta_cancel(int num_sleepers, int *ops) {
+    return bench_sleep_cancel(&g_delta_impl, num_sleepers, ops);
+}
+
+/**
+ * Puts num_sleepers processes to sleep for random times, up to 10 seconds
+ * @param impl - the sleep device
+ * @param num_sleepers - number of sleeping processes
+ * @param[out] procs - the sleeping processes
+ * @return cycles spent in the sleep calls
+ */
+static unsigned long bench_sleep_insert(sleep_impl_t *impl, int num_sleepers,
+                                        proc_ctrl_block_t **procs) {
+    unsigned long cycles = 0;
+
+    ASSERT(num_sleepers <= BENCH_MAX_SLEEPERS);
+    for (int i = 0; i < num_sleepers; i++) {
+        procs[i] = create_bench_proc();
+        remove_pcb_from_queue(procs[i]);
+    }
+
+    for (int i = 0; i < num_sleepers; i++) {
+        unsigned int time = 1 + rand() % 10000;
+
+        unsigned long long start = rdtsc();
+        impl->sleep(procs[i], time);
+        cycles += (unsigned long)(rdtsc() - start);
+    }
+    return cycles;
+}
+
+/**
+ * Ticks until num_sleepers processes sleeping for random times all wake up
+ * @param impl - the sleep device
+ * @param num_sleepers - number of sleeping processes
+ * @param[out] ops - number of ticks
+ * @return cycles spent
+ */
+static unsigned long bench_sleep_tick(sleep_impl_t *impl, int num_sleepers,
+                                      int *ops) {
+    proc_ctrl_block_t *procs[BENCH_MAX_SLEEPERS];
+    bench_sleep_insert(impl, num_sleepers, procs);
+
+    *ops = 0;
+    unsigned long long start = rdtsc();
+    while (!impl->empty()) {
+        impl->tick();
+        (*ops)++;
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Wakes num_sleepers sleeping processes early, in random order,
+ * as signals do
+ * @param impl - the sleep device
+ * @param num_sleepers - number of sleeping processes
+ * @param[out] ops - number of processes woken
+ * @return cycles spent
+ */
+static unsigned long bench_sleep_cancel(sleep_impl_t *impl, int num_sleepers,
+                                        int *ops) {
+    proc_ctrl_block_t *procs[BENCH_MAX_SLEEPERS];
+    bench_sleep_insert(impl, num_sleepers, procs);
+
+    for (int i = num_sleepers - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        proc_ctrl_block_t *swap = procs[i];
+        procs[i] = procs[j];
+        procs[j] = swap;
+    }
+
+    *ops = num_sleepers;
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < num_sleepers; i++) {
+        impl->wake(procs[i]);
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Whether any process is sleeping in the timer wheel
+ * @return 1 if no process is sleeping, 0 otherwise
+ */
+static int wheel_empty(void) {
+    return ticks_until_wake() < 0;
+}
+
+/**
+ * Passes len byte messages between two processes, sender first
+ * @param len - message length
+ * @param[out] ops - number of messages passed
+ * @return cycles spent
+ */
+static unsigned long bench_send_recv(int len, int *ops) {
+    static char send_buf[64 * 1024];
+    static char recv_buf[64 * 1024];
+    unsigned long send_args[3];
+    unsigned long recv_args[3];
+    int from_pid;
+
+    ASSERT(len <= sizeof(send_buf));
+    memset(send_buf, 'x', sizeof(send_buf));
+
+    proc_ctrl_block_t *sender = create_bench_proc();
+    proc_ctrl_block_t *receiver = create_bench_proc();
+    remove_pcb_from_queue(sender);
+    remove_pcb_from_queue(receiver);
+
+    // args as the dispatcher would see them on the processes' stacks
+    send_args[0] = receiver->pid;
+    send_args[1] = (unsigned long)send_buf;
+    send_args[2] = len;
+    sender->args = send_args;
+
+    from_pid = sender->pid;
+    recv_args[0] = (unsigned long)&from_pid;
+    recv_args[1] = (unsigned long)recv_buf;
+    recv_args[2] = len;
+    receiver->args = recv_args;
+
+    // keep large messages from overflowing the 32 bit cycle count
+    *ops = (len <= 1024) ? 10000 : 10000 * 1024 / len;
+    unsigned long long start = rdtsc();
+    for (int i = 0; i < *ops; i++) {
+        sender->curr_state = PROC_STATE_BLOCKED;
+        send(sender, receiver, send_buf, len);
+        recv(sender, receiver, recv_buf, len);
+
+        // recv readied the sender, take it back off the ready queue
+        remove_pcb_from_queue(sender);
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Posts a full mailbox's worth of len byte messages, then receives them all
+ * @param len - message length
+ * @param[out] ops - number of messages passed
+ * @return cycles spent
+ */
+static unsigned long bench_mbox(int len, int *ops) {
+    char send_buf[MBOX_MSG_SIZE];
+    char recv_buf[MBOX_MSG_SIZE];
+    int from_pid;
+
+    memset(send_buf, 'x', sizeof(send_buf));
+
+    proc_ctrl_block_t *poster = create_bench_proc();
+    proc_ctrl_block_t *owner = create_bench_proc();
+
+    *ops = 0;
+    unsigned long long start = rdtsc();
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < MBOX_CAPACITY; i++) {
+            post(poster, owner, send_buf, len);
+        }
+        for (int i = 0; i < MBOX_CAPACITY; i++) {
+            mbox_recv(owner, &from_pid, recv_buf, len);
+        }
+        *ops += MBOX_CAPACITY;
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Fires num_signals signals at a process, then delivers them one at a time
+ * @param num_signals - signals per storm
+ * @param[out] ops - number of signals delivered
+ * @return cycles spent
+ */
+static unsigned long bench_signal_storm_single(int num_signals, int *ops) {
+    return bench_signal_storm(0, num_signals, ops);
+}
+
+/**
+ * Fires num_signals signals at a process, then delivers them all at once
+ * @param num_signals - signals per storm
+ * @param[out] ops - number of signals delivered
+ * @return cycles spent
+ */
+static unsigned long bench_signal_storm_batch(int num_signals, int *ops) {
+    return bench_signal_storm(1, num_signals, ops);
+}
+
+/**
+ * Fires num_signals signals at a process, and delivers them the way the
+ * kernel would as it switches to the process, until none are left. Each
+ * delivery is followed by what dispatch_syscall_sigreturn does once the
+ * process's handlers have run.
+ * @param batch - passed to deliver_signals_as, 1 to deliver in one batch
+ * @param num_signals - signals per storm
+ * @param[out] ops - number of signals delivered
+ * @return cycles spent
+ */
+static unsigned long bench_signal_storm(int batch, int num_signals, int *ops) {
+    proc_ctrl_block_t *proc = create_bench_proc();
+    for (int i = 0; i < SIGNAL_TABLE_SIZE; i++) {
+        proc->signal_table[i] = &storm_handler;
+    }
+
+    *ops = 0;
+    g_storm_traps = 0;
+    unsigned long long start = rdtsc();
+    for (int storm = 0; storm < 1000; storm++) {
+        for (int i = 0; i < num_signals; i++) {
+            set_proc_signal(proc, i);
+        }
+
+        while (proc->signals_fired != 0) {
+            void *old_sp = proc->esp;
+            int old_ret = proc->ret;
+
+            deliver_signals_as(proc, batch);
+
+            // the trap back in through syssigreturn
+            proc->ret = old_ret;
+            proc->esp = old_sp;
+            proc->signals_enabled = 1;
+            g_storm_traps++;
+        }
+        *ops += num_signals;
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Queues num_signals masked signals at a process, which takes them all
+ * back the way syssigwait does
+ * @param num_signals - signals queued before they are taken
+ * @param[out] ops - number of signals taken
+ * @return cycles spent
+ */
+static unsigned long bench_sigqueue_sigwait(int num_signals, int *ops) {
+    proc_ctrl_block_t *proc = create_bench_proc();
+    proc->signals_masked = (unsigned int)-1;
+
+    *ops = 0;
+    unsigned long long start = rdtsc();
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < num_signals; i++) {
+            queue_proc_signal(proc, i % SIGNAL_TABLE_SIZE, i);
+        }
+
+        unsigned long value;
+        while (take_highest_signal(proc, (unsigned int)-1, &value) >= 0) {
+            (*ops)++;
+        }
+    }
+    return (unsigned long)(rdtsc() - start);
+}
+
+/**
+ * Handler for the signal storms. Never run.
+ */
+static void storm_handler(void *cntx) {
+    (void)cntx;
+    ASSERT(0);
+}
+
+/**
+ * Creates a ready process which is never run
+ * @return the process's pcb
+ */
+static proc_ctrl_block_t* create_bench_proc(void) {
+    proc_ctrl_block_t *proc = pid_to_proc(create(&dummy, DEFAULT_STACK_SIZE));
+    ASSERT(proc != NULL);
+    return proc;
+}
+
+/**
+ * Dummy func, for use by create(). Never run.
+ */
+static void dummy(void) {
+    ASSERT(0);
+}
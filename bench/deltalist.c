@@ -0,0 +1,102 @@
+/* deltalist.c : the delta list sleep device, kept as a benchmark baseline
+
+Provides:
+  delta_init() - empties the delta list
+  delta_sleep() - puts a process to sleep, like sleep()
+  delta_wake() - ends the sleep of a process, like wake()
+  delta_tick() - ends a time slice, like tick()
+  delta_list_empty() - whether any process is sleeping
+
+Note:
+  This is how c/sleep.c kept sleeping processes before the timer wheel.
+  Each proc's proc->ret holds its ticks left after the proc ahead of it,
+  so inserting walks the list, while a tick only touches the head.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+static proc_ctrl_block_t *g_delta_list;
+
+static void remove_from_delta_list(proc_ctrl_block_t *proc);
+
+void delta_init(void) {
+    g_delta_list = NULL;
+}
+
+void delta_sleep(proc_ctrl_block_t *proc, unsigned int time) {
+    ASSERT(time > 0);
+    proc->curr_state = PROC_STATE_BLOCKED;
+    proc->blocking_queue_name = SLEEP;
+    proc->blocking_proc = NULL;
+
+    proc->ret = time / TICK_LENGTH_IN_MS + (time % TICK_LENGTH_IN_MS ? 1 : 0);
+
+    proc_ctrl_block_t *prev = NULL;
+    proc_ctrl_block_t *entry = g_delta_list;
+
+    while (entry != NULL && proc->ret > entry->ret) {
+        proc->ret -= entry->ret;
+        prev = entry;
+        entry = entry->next_proc;
+    }
+
+    if (prev == NULL) {
+        g_delta_list = proc;
+    } else {
+        prev->next_proc = proc;
+    }
+
+    proc->next_proc = entry;
+    proc->prev_proc = prev;
+
+    if (proc->next_proc != NULL) {
+        proc->next_proc->prev_proc = proc;
+        proc->next_proc->ret -= proc->ret;
+    }
+}
+
+void delta_wake(proc_ctrl_block_t *proc) {
+    ASSERT_EQUAL(proc->blocking_queue_name, SLEEP);
+
+    remove_from_delta_list(proc);
+    proc->blocking_queue_name = NO_BLOCKER;
+
+    proc->ret *= TICK_LENGTH_IN_MS;
+}
+
+void delta_tick(void) {
+    if (g_delta_list == NULL) {
+        return;
+    }
+
+    g_delta_list->ret--;
+    while (g_delta_list != NULL && g_delta_list->ret <= 0) {
+        proc_ctrl_block_t *proc = g_delta_list;
+        delta_wake(proc);
+        add_pcb_to_queue(proc, PROC_STATE_READY);
+    }
+}
+
+int delta_list_empty(void) {
+    return g_delta_list == NULL;
+}
+
+static void remove_from_delta_list(proc_ctrl_block_t *proc) {
+    if (proc->prev_proc) {
+        proc->prev_proc->next_proc = proc->next_proc;
+    }
+
+    if (proc->next_proc) {
+        proc->next_proc->ret += proc->ret;
+        proc->next_proc->prev_proc = proc->prev_proc;
+    }
+
+    if (g_delta_list == proc) {
+        g_delta_list = proc->next_proc;
+    }
+
+    proc->prev_proc = NULL;
+    proc->next_proc = NULL;
+}
@@ -0,0 +1,35 @@
+/* i386.h - host stand-in for h/i386.h, used by the benchmark build only
+
+   The kernel's heap is laid out around fixed physical addresses. Here those
+   addresses are moved into bench_arena, a static buffer in the benchmark
+   program, so c/mem.c can run unmodified as a Linux process.
+ */
+
+#define	NBPG		4096
+#define KERNEL_STACK	(4*4096)
+
+#define BENCH_ARENA_SIZE (16 * 1024 * 1024)
+extern char bench_arena[BENCH_ARENA_SIZE];
+
+#define HOLESIZE        (600)
+#define HOLESTART       ((long)bench_arena + 640 * 1024)
+#define HOLEEND         ((long)bench_arena + (1024 + HOLESIZE) * 1024)
+
+/* the whole arena is one usable region, see bench_reset() */
+#define	MAX_MEM_REGIONS	16
+
+struct memregion {
+	unsigned long	mr_start;
+	unsigned long	mr_end;
+};
+
+extern struct memregion	memregions[];
+extern int		nmemregions;
+
+/* c/clock.c calibrates against the PIT, which the benchmarks never do */
+#define TIMER_FREQ      1193182
+
+/* Some helpful prototypes */
+unsigned long long rdtsc( void );
+void oneshotCountPIT( unsigned int count );
+unsigned int readPIT( void );
@@ -0,0 +1,139 @@
+/* stubs.c : host stand-ins for the parts of the kernel the benchmarks skip
+
+Provides:
+  bench_exit() - ends the benchmark process
+  kprintf() - formatted output to stdout, through a Linux write() syscall
+  rdtsc() - returns the CPU's time stamp counter, in cycles
+
+  Everything else here satisfies the linker for code that is never reached
+  from a benchmark: hardware access, and the user side of syscalls.
+
+Note:
+  The benchmark is linked without a C library, so the only way out of the
+  process is the raw Linux i386 syscall interface, int $0x80.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+#include <stdarg.h>
+
+#define LINUX_SYS_EXIT 1
+#define LINUX_SYS_WRITE 4
+#define LINUX_STDOUT 1
+
+#define OUTPUT_BUFFER_SIZE 1024
+
+char bench_arena[BENCH_ARENA_SIZE] __attribute__((aligned(NBPG)));
+long freemem;
+char *maxaddr;
+struct memregion memregions[MAX_MEM_REGIONS];
+int nmemregions;
+
+static char g_output_buffer[OUTPUT_BUFFER_SIZE];
+static int g_output_len = 0;
+
+static void flush_output(void);
+static int kputc(int dev, unsigned char c);
+
+/**
+ * Flushes stdout, and ends the benchmark process. Does not return.
+ * @param status - process exit status
+ */
+void bench_exit(int status) {
+    flush_output();
+    __asm__ volatile("int $0x80"
+                     : /* no outputs */
+                     : "a" (LINUX_SYS_EXIT), "b" (status));
+    while(1);
+}
+
+/**
+ * Formatted output to stdout, buffered until a newline
+ * @param fmt - printf style format string
+ * @return 1
+ */
+int kprintf(char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    _doprnt(fmt, (void *)ap, kputc, 0);
+    va_end(ap);
+    return 1;
+}
+
+/**
+ * Returns the CPU's time stamp counter
+ * @return cycles since reset
+ */
+unsigned long long rdtsc(void) {
+    unsigned long long tsc;
+    __asm__ volatile("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/**
+ * Buffers a character for stdout
+ * @param dev - unused
+ * @param c - character to write
+ * @return c
+ */
+static int kputc(int dev, unsigned char c) {
+    (void)dev;
+
+    g_output_buffer[g_output_len++] = c;
+    if (c == '\n' || g_output_len == OUTPUT_BUFFER_SIZE) {
+        flush_output();
+    }
+    return (int)c;
+}
+
+/**
+ * Writes out everything buffered for stdout
+ */
+static void flush_output(void) {
+    int ret;
+    __asm__ volatile("int $0x80"
+                     : "=a" (ret)
+                     : "a" (LINUX_SYS_WRITE), "b" (LINUX_STDOUT),
+                       "c" (g_output_buffer), "d" (g_output_len)
+                     : "memory");
+    (void)ret;
+    g_output_len = 0;
+}
+
+/******************************************************************************
+ * Never reached from a benchmark
+ ******************************************************************************/
+
+unsigned short getCS(void) {
+    return 0;
+}
+
+int di_close(proc_ctrl_block_t *proc, int fd) {
+    (void)proc;
+    (void)fd;
+    return SYSERR;
+}
+
+void di_cancel_read(proc_ctrl_block_t *proc) {
+    (void)proc;
+}
+
+void sysstop(void) {
+    ASSERT(0);
+}
+
+void syssigreturn(void *old_sp) {
+    (void)old_sp;
+    ASSERT(0);
+}
+
+void oneshotCountPIT(unsigned int count) {
+    (void)count;
+    ASSERT(0);
+}
+
+unsigned int readPIT(void) {
+    ASSERT(0);
+    return 0;
+}
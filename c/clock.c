@@ -0,0 +1,241 @@
+/* clock.c : clocksource, the TSC calibrated against the PIT
+
+Called from outside:
+  clock_init() - measures the TSC's rate against PIT channel 0
+  clock_set_khz() - sets the TSC's rate directly, when it is already known
+  clock_get_khz() - returns the TSC's rate
+
+  clock_ns() - nanoseconds since clock_init
+
+  clock_cycles_to_ns(), clock_cycles_to_us(), clock_cycles_to_ms(),
+  clock_cycles_to_ticks(), clock_cycles_to_pit(), clock_us_to_cycles()
+    - convert between TSC cycles and other units
+
+  clock_mark_tick() - records that a timer tick just happened
+  clock_next_tick() - TSC value the next timer tick is due at
+
+Note:
+  The TSC counts cpu cycles, so it is far finer than the PIT's ticks, and
+  reading it is a single instruction. Its rate is not known in advance,
+  though, so clock_init counts how many cycles pass while PIT channel 0,
+  whose rate is fixed at TIMER_FREQ, counts down CALIBRATE_MS milliseconds.
+  This must run before initPIT, as it reprograms channel 0.
+
+  The kernel has no 64 bit division (there is no libgcc), so conversions
+  are done with udiv64, which divides a 64 bit value by a 32 bit one with
+  two divl instructions. Cycles are split into whole milliseconds and a
+  remainder of less than a millisecond, so scaling the remainder to any
+  finer unit can not overflow.
+
+Further details can be found in the documentation above the function headers.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+#include <clock.h>
+
+#define CALIBRATE_MS 10
+#define CALIBRATE_PIT_COUNTS (TIMER_FREQ / (1000 / CALIBRATE_MS))
+
+// the longest one-shot the PIT's 16 bit counter allows, and in milliseconds
+#define PIT_MAX_COUNT 0xffff
+#define PIT_MAX_MS (PIT_MAX_COUNT / (TIMER_FREQ / 1000))
+
+// TSC rate, and TSC values at clock_init and at the last timer tick
+static unsigned long g_tsc_khz = 1;
+static unsigned long long g_boot_cycles;
+static unsigned long long g_tick_cycles;
+
+static unsigned long long cycles_to_units(unsigned long long cycles,
+                                          unsigned long units_per_ms);
+static unsigned long long udiv64(unsigned long long dividend,
+                                 unsigned long divisor,
+                                 unsigned long *remainder);
+
+/**
+ * Measures the TSC's rate against PIT channel 0.
+ * Must be called with interrupts disabled, before initPIT.
+ */
+void clock_init(void) {
+    oneshotCountPIT(PIT_MAX_COUNT);
+
+    // the count is only loaded on the PIT's next clock, so wait for it to
+    // be counting down before starting
+    unsigned int start_count;
+    do {
+        start_count = readPIT();
+    } while (start_count > PIT_MAX_COUNT - 2 ||
+             start_count < CALIBRATE_PIT_COUNTS * 2);
+
+    unsigned long long start = rdtsc();
+    unsigned int count;
+    unsigned long long end;
+    do {
+        count = readPIT();
+        end = rdtsc();
+    } while (start_count - count < CALIBRATE_PIT_COUNTS);
+
+    // cycles per PIT count, scaled up to cycles per millisecond
+    unsigned long long khz =
+        udiv64((end - start) * TIMER_FREQ, (start_count - count) * 1000, NULL);
+
+    clock_set_khz(MAX((unsigned long)khz, 1));
+}
+
+/**
+ * Sets the TSC's rate, and restarts clock_ns from 0
+ * @param khz - TSC cycles per millisecond
+ */
+void clock_set_khz(unsigned long khz) {
+    ASSERT(khz > 0);
+    g_tsc_khz = khz;
+    g_boot_cycles = rdtsc();
+    g_tick_cycles = g_boot_cycles;
+}
+
+/**
+ * Returns the TSC's rate
+ * @return TSC cycles per millisecond
+ */
+unsigned long clock_get_khz(void) {
+    return g_tsc_khz;
+}
+
+/**
+ * Returns the time since clock_init
+ * @return nanoseconds since clock_init
+ */
+unsigned long long clock_ns(void) {
+    return clock_cycles_to_ns(rdtsc() - g_boot_cycles);
+}
+
+/**
+ * Converts TSC cycles to nanoseconds, rounding down
+ * @param cycles - the cycles to convert
+ * @return the nanoseconds cycles take
+ */
+unsigned long long clock_cycles_to_ns(unsigned long long cycles) {
+    return cycles_to_units(cycles, 1000000);
+}
+
+/**
+ * Converts TSC cycles to microseconds, rounding down
+ * @param cycles - the cycles to convert
+ * @return the microseconds cycles take
+ */
+unsigned long long clock_cycles_to_us(unsigned long long cycles) {
+    return cycles_to_units(cycles, 1000);
+}
+
+/**
+ * Converts TSC cycles to milliseconds, rounding down
+ * @param cycles - the cycles to convert
+ * @return the milliseconds cycles take
+ */
+unsigned long long clock_cycles_to_ms(unsigned long long cycles) {
+    return udiv64(cycles, g_tsc_khz, NULL);
+}
+
+/**
+ * Converts TSC cycles to timer ticks, rounding down
+ * @param cycles - the cycles to convert
+ * @return the whole ticks cycles take, at most (unsigned long)-1
+ */
+unsigned long clock_cycles_to_ticks(unsigned long long cycles) {
+    unsigned long long ticks =
+        udiv64(cycles, g_tsc_khz * TICK_LENGTH_IN_MS, NULL);
+    return (ticks >> 32) ? (unsigned long)-1 : (unsigned long)ticks;
+}
+
+/**
+ * Converts TSC cycles to a count for oneshotCountPIT, rounding up,
+ * so a one-shot never goes off before cycles have passed
+ * @param cycles - the cycles to convert
+ * @return PIT counts cycles take, from 1 to the PIT's maximum
+ */
+unsigned int clock_cycles_to_pit(unsigned long long cycles) {
+    if (cycles >= (unsigned long long)g_tsc_khz * PIT_MAX_MS) {
+        return PIT_MAX_COUNT;
+    }
+
+    // 1000 times the counts first, so the rate of the PIT is exact
+    unsigned long long counts =
+        udiv64(udiv64(cycles * TIMER_FREQ, g_tsc_khz, NULL), 1000, NULL);
+    return MIN((unsigned int)counts + 1, PIT_MAX_COUNT);
+}
+
+/**
+ * Converts microseconds to TSC cycles, rounding down
+ * @param us - the microseconds to convert
+ * @return the cycles us take
+ */
+unsigned long long clock_us_to_cycles(unsigned int us) {
+    unsigned long long ms_cycles = (unsigned long long)(us / 1000) * g_tsc_khz;
+    return ms_cycles +
+        udiv64((unsigned long long)(us % 1000) * g_tsc_khz, 1000, NULL);
+}
+
+/**
+ * Records that a timer tick just happened, so clock_next_tick knows when
+ * the next is due. Called for every tick, and whenever the timer is
+ * restarted in periodic mode.
+ */
+void clock_mark_tick(void) {
+    g_tick_cycles = rdtsc();
+}
+
+/**
+ * Returns when the next timer tick is due, if the timer is periodic
+ * @return TSC value at the next tick
+ */
+unsigned long long clock_next_tick(void) {
+    return g_tick_cycles + (unsigned long long)g_tsc_khz * TICK_LENGTH_IN_MS;
+}
+
+/**
+ * Converts TSC cycles to a finer unit, without overflowing on large counts
+ * @param cycles - the cycles to convert
+ * @param units_per_ms - units in a millisecond
+ * @return the units cycles take, rounded down
+ */
+static unsigned long long cycles_to_units(unsigned long long cycles,
+                                          unsigned long units_per_ms) {
+    unsigned long remainder;
+    unsigned long long ms = udiv64(cycles, g_tsc_khz, &remainder);
+
+    // remainder < g_tsc_khz, so this fits in 64 bits for any 32 bit rate
+    return ms * units_per_ms +
+        udiv64((unsigned long long)remainder * units_per_ms, g_tsc_khz, NULL);
+}
+
+/**
+ * Divides a 64 bit value by a 32 bit one
+ * @param dividend - the value to divide
+ * @param divisor - the value to divide by, not 0
+ * @param[out] remainder - if not NULL, set to dividend % divisor
+ * @return dividend / divisor
+ */
+static unsigned long long udiv64(unsigned long long dividend,
+                                 unsigned long divisor,
+                                 unsigned long *remainder) {
+    unsigned long high = dividend >> 32;
+    unsigned long low = (unsigned long)dividend;
+
+    // divl faults if the quotient does not fit in 32 bits,
+    // so divide the high word on its own first
+    unsigned long quotient_high = high / divisor;
+    high %= divisor;
+
+    unsigned long quotient_low;
+    unsigned long rem;
+    __asm__("divl %4"
+            : "=a" (quotient_low), "=d" (rem)
+            : "a" (low), "d" (high), "rm" (divisor));
+
+    if (remainder != NULL) {
+        *remainder = rem;
+    }
+
+    return ((unsigned long long)quotient_high << 32) | quotient_low;
+}
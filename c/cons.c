@@ -0,0 +1,123 @@
+/* cons.c: Console device specific code
+
+Called from outside:
+  cons_devsw_create() - fills in a device table entry for the console
+  cons_init(), cons_open(), cons_close(), cons_read(), cons_write(),
+  cons_writev(), cons_ioctl(), cons_iint(), cons_oint()
+    - implementations of the devsw functions
+
+Note:
+  A write goes to the screen as one block through kconsole_write, which
+  scrolls once for all the lines it adds and writes the glyphs straight
+  into video memory. The cursor is moved once at the end of each write,
+  or of each writev, rather than once per character as kprintf used to,
+  so the port I/O a write costs does not grow with its length.
+
+  Any number of processes may have the console open. It can not be read.
+
+Further details can be found in the documentation above the function headers.
+*/
+
+#include <xeroslib.h>
+#include <cons.h>
+
+/**
+ * Fills in a device table entry with console-device specific values
+ * @param entry - device table entry to be modified
+ */
+void cons_devsw_create(devsw_t *entry) {
+    ASSERT(entry != NULL);
+    
+    sprintf(entry->dvname, "console");
+    entry->dvinit = &cons_init;
+    entry->dvopen = &cons_open;
+    entry->dvclose = &cons_close;
+    entry->dvread = &cons_read;
+    entry->dvwrite = &cons_write;
+    entry->dvreadv = NULL;
+    entry->dvwritev = &cons_writev;
+    entry->dvioctl = &cons_ioctl;
+    entry->dvcancel = NULL;
+    entry->dviint = &cons_iint;
+    entry->dvoint = &cons_oint;
+    entry->dvminor = 0;
+    entry->dvioblk = NULL;
+}
+
+/******************************************************************************
+ * Implementations of devsw abstract functions
+ ******************************************************************************/
+
+int cons_init(void) {
+    return 0;
+}
+
+int cons_open(proc_ctrl_block_t *proc, void *dvioblk) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    
+    return 0;
+}
+
+int cons_close(proc_ctrl_block_t *proc, void *dvioblk) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    
+    return 0;
+}
+
+int cons_read(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    (void)buf;
+    (void)buflen;
+    // Cannot read from console
+    return -1;
+}
+
+int cons_write(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    
+    kconsole_write(buf, buflen);
+    kconsole_cursor();
+    return buflen;
+}
+
+int cons_writev(proc_ctrl_block_t *proc, void *dvioblk,
+                const iovec_t *iov, int iovcnt) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    
+    int total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        kconsole_write(iov[i].iov_base, iov[i].iov_len);
+        total += iov[i].iov_len;
+    }
+    
+    kconsole_cursor();
+    return total;
+}
+
+int cons_ioctl(proc_ctrl_block_t *proc, void *dvioblk, unsigned long command, void *args) {
+    // unused
+    (void)proc;
+    (void)dvioblk;
+    (void)command;
+    (void)args;
+    
+    return SYSERR;
+}
+
+int cons_iint(void) {
+    return -1;
+}
+
+int cons_oint(void) {
+    return -1;
+}
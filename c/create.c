@@ -34,7 +34,7 @@ int create(funcptr func, int stack) {
         stack = DEFAULT_STACK_SIZE;
     }
 
-    void *stack_bottom = kmalloc(stack);
+    void *stack_bottom = stackpool_alloc(stack);
     if (stack_bottom == NULL) {
         return ENOMEM;
     }
@@ -44,7 +44,7 @@ int create(funcptr func, int stack) {
     proc_ctrl_block_t *new_proc = get_next_available_pcb();
     if (new_proc == NULL) {
         DEBUG("Could not find a pcb!\n");
-        kfree(stack_bottom);
+        stackpool_free(stack_bottom);
         return EPROCLIMIT;
     }
 
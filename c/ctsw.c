@@ -4,6 +4,16 @@ Called from outside:
     ctsw_init_evec() - initializes irq handlers to enter the context switcher
     
     ctsw_contextswitch() - context switch from kernel to user process
+    ctsw_get_fast_yields() - yields which returned without entering the kernel
+
+Note:
+  A sysyield which would only put the process back on the cpu is turned
+  around at the syscall entry point: it irets straight back, without saving
+  the process's context or switching to the kernel stack. Whether that is
+  the case is decided as the kernel switches to the process, and holds
+  until the kernel next runs, since only the kernel changes the ready
+  queues. Fast yields are not seen by the dispatcher, so are not counted by
+  sysstat, and their few cycles are charged as user time.
 
 Further details can be found in the documentation above the function headers.
 */
@@ -19,10 +29,19 @@ void _timer_entry_point(void);
 void _keyboard_entry_point(void);
 void _syscall_entry_point(void);
 void _common_entry_point(void);
-static void *kern_stack_ptr;
-static unsigned long *ESP;
+
+// Referenced by name from the asm below, which the compiler can not see,
+// so they are kept and re-read even when optimising
+#define ASM_VISIBLE __attribute__((used)) volatile
+
+static void * ASM_VISIBLE kern_stack_ptr;
+static unsigned long * ASM_VISIBLE ESP;
 static unsigned long REQ_ID;
-static int ctsw_reason;
+static int ASM_VISIBLE ctsw_reason;
+
+// nonzero if a yield by the proc being switched to would switch back to it
+static int ASM_VISIBLE yield_to_self;
+static unsigned int ASM_VISIBLE fast_yields;
 
 /**
  * Sets the syscall and timer interrupt handlers
@@ -39,11 +58,8 @@ void ctsw_init_evec(void) {
  * @param proc: process to switch to
  */
 syscall_request_id_t ctsw_contextswitch(proc_ctrl_block_t *proc) {
-    // for getting rid of unused param compiler warning
-    (void)kern_stack_ptr;
-
-    if (proc->signals_fired && proc->signals_enabled) {
-        call_highest_priority_signal(proc);
+    if (proc->signals_enabled && deliverable_signals(proc)) {
+        deliver_signals(proc);
     }
 
     context_frame_t *cf;
@@ -52,6 +68,8 @@ syscall_request_id_t ctsw_contextswitch(proc_ctrl_block_t *proc) {
 
     cf = (context_frame_t *)proc->esp;
     cf->eax = proc->ret;
+
+    yield_to_self = !ready_proc_waiting(proc);
     
     __asm__ volatile( " \
         pushf \n\
@@ -62,6 +80,13 @@ syscall_request_id_t ctsw_contextswitch(proc_ctrl_block_t *proc) {
         iret \n\
 _syscall_entry_point: \n\
         cli \n\
+        cmpl $0, yield_to_self \n\
+        je _syscall_slow_path \n\
+        cmpl %0, 12(%%esp) \n\
+        jne _syscall_slow_path \n\
+        incl fast_yields \n\
+        iret \n\
+_syscall_slow_path: \n\
         pusha \n\
         movl $0, ctsw_reason \n\
         jmp _common_entry_point \n\
@@ -81,8 +106,8 @@ _common_entry_point: \n\
         popa \n\
         popf \n"
     : /* no outputs */
-    : /* no range */
-    : "%eax"
+    : "i" (SYSCALL_YIELD)
+    : "%eax", "memory"
     );
     
     proc->esp = ESP;
@@ -111,3 +136,11 @@ _common_entry_point: \n\
 
     return REQ_ID;
 }
+
+/**
+ * Returns how many yields were turned around at the syscall entry point
+ * @return fast yields since boot
+ */
+unsigned int ctsw_get_fast_yields(void) {
+    return fast_yields;
+}
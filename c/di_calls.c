@@ -6,13 +6,17 @@ Called from outside:
     di_close() - close fd
     di_write() - write to device
     di_read() - read from device
+    di_writev() - write several buffers to device
+    di_readv() - read from device into several buffers
     di_ioctl() - special control
+    di_cancel_read() - abandons the read a process is blocked on
     
 Further details can be found in the documentation above the function headers.
  */
 
 #include <xeroskernel.h>
 #include <kbd.h>
+#include <cons.h>
 
 // Device table
 static devsw_t g_device_table[NUM_DEVICES_ID_ENUMS];
@@ -25,6 +29,7 @@ static int check_fd(proc_ctrl_block_t* proc, int fd);
 void di_init_devtable(void) {
     kbd_devsw_create(&g_device_table[DEVICE_ID_KEYBOARD_NO_ECHO], 0);
     kbd_devsw_create(&g_device_table[DEVICE_ID_KEYBOARD], 1);
+    cons_devsw_create(&g_device_table[DEVICE_ID_CONSOLE]);
     
     for (int i = 0; i < NUM_DEVICES_ID_ENUMS; i++) {
         g_device_table[i].dvinit();
@@ -129,6 +134,104 @@ int di_read(proc_ctrl_block_t *proc, int fd, void *buf, int buflen) {
                                       buf, buflen);
 }
 
+/**
+ * Writes several buffers to a device, in order. Devices without a dvwritev
+ * have dvwrite called for each buffer, until one is not written in full.
+ * @param proc - process owning the fd
+ * @param fd - process's file descriptor for the open device
+ * @param iov - the buffers to write, already checked by the caller
+ * @param iovcnt - number of buffers in iov
+ * @return number of bytes written, or -1 on failure
+ */
+int di_writev(proc_ctrl_block_t *proc, int fd,
+              const iovec_t *iov, int iovcnt) {
+    ASSERT(proc != NULL && (iov != NULL || iovcnt == 0));
+
+    if (check_fd(proc, fd)) {
+        return SYSERR;
+    }
+
+    devsw_t *entry = proc->fd_table[fd];
+    if (entry->dvwritev != NULL) {
+        return entry->dvwritev(proc, entry->dvioblk, iov, iovcnt);
+    }
+
+    int total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        int written = entry->dvwrite(proc, entry->dvioblk,
+                                     iov[i].iov_base, iov[i].iov_len);
+        if (written < 0) {
+            // report what was written before the failure, as a short write
+            return total > 0 ? total : written;
+        }
+
+        total += written;
+        if (written < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * Reads from a device into several buffers, filling each in turn. Devices
+ * without a dvreadv have dvread called for each buffer, until one is not
+ * filled. Only a read of the first buffer may block, as a later one
+ * would lose the bytes already read, so the process is then woken with
+ * only that buffer's count.
+ * @param proc - process owning the fd
+ * @param fd - process's file descriptor for the open device
+ * @param iov - the buffers to read into, already checked by the caller
+ * @param iovcnt - number of buffers in iov
+ * @return number of bytes read, BLOCKERR if the process must block,
+ *         or -1 on failure
+ */
+int di_readv(proc_ctrl_block_t *proc, int fd,
+             const iovec_t *iov, int iovcnt) {
+    ASSERT(proc != NULL && (iov != NULL || iovcnt == 0));
+
+    if (check_fd(proc, fd)) {
+        return SYSERR;
+    }
+
+    devsw_t *entry = proc->fd_table[fd];
+    if (entry->dvreadv != NULL) {
+        return entry->dvreadv(proc, entry->dvioblk, iov, iovcnt);
+    }
+
+    int total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        int bytes = entry->dvread(proc, entry->dvioblk,
+                                  iov[i].iov_base, iov[i].iov_len);
+        if (bytes == BLOCKERR && total > 0) {
+            if (entry->dvcancel != NULL) {
+                entry->dvcancel(proc, entry->dvioblk);
+            }
+            return total;
+        }
+
+        if (bytes < 0) {
+            return total > 0 ? total : bytes;
+        }
+
+        total += bytes;
+        if (bytes < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 /**
  * Device specific control
  * @param proc - process owning the fd
@@ -149,6 +252,23 @@ int di_ioctl(proc_ctrl_block_t *proc, int fd,
                                        command_code, args);
 }
 
+/**
+ * Abandons the device read a process is blocked on, when it is unblocked
+ * by a signal or killed. A process blocks on one read at a time, so each
+ * device it has open is told, and those not holding the read ignore it.
+ * @param proc - process blocked on a device read
+ */
+void di_cancel_read(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    for (int fd = 0; fd < PCB_NUM_FDS; fd++) {
+        devsw_t *entry = proc->fd_table[fd];
+        if (entry != NULL && entry->dvcancel != NULL) {
+            entry->dvcancel(proc, entry->dvioblk);
+        }
+    }
+}
+
 /**
  * Ensures a file descriptor is valid
  * @param proc - proc who owns fd
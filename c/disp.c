@@ -4,18 +4,58 @@ Called from outside:
     dispinit() - initializes dispatcher
     
     dispatch() - starts the root process
-    
+
+    get_avoided_timer_ints() - timer interrupts skipped by tickless idle
+
+Note:
+  When only the idle proc can run, the timer is switched from periodic to
+  one-shot mode, timed to go off when the first sleeping proc wakes. Periodic
+  ticks resume as soon as anything else can run. The PIT can only count about
+  5 ticks ahead, so long idle periods are covered by a chain of one-shots.
+
+  A proc in syssleep_us may be due between ticks. When the first such short
+  sleeper is due before the next tick, a one-shot is armed for its deadline
+  instead, then another for the tick it displaced, after which the timer
+  is periodic again. Tick boundaries are tracked with the TSC, see clock.c,
+  so short sleepers never shift when the ticks fall.
+
+  CPU time is counted in TSC cycles, timestamped as ctsw returns to the
+  kernel and just before it leaves for a proc. The proc that was running
+  is charged the time since it was switched to as user time, and the time
+  the kernel then spends on the entry, up to switching to the next proc, as
+  kernel time for a syscall, or interrupt time for an interrupt. A proc
+  which blocks or yields partway through a time slice only pays for what
+  it used.
+
+  A process may batch syscalls in a ring it registers with sysring_register,
+  then run them all with a single sysring_submit trap. Each entry runs
+  through the same handler as the equivalent trap. If an entry blocks, the
+  batch stops there, and the entry's result is returned by the trap when the
+  process wakes; the user side of sysring_submit then resubmits the rest.
+
+  Every request is counted, and the cycles spent handling it are measured
+  with rdtsc, from ctsw returning to the handler finishing. sysstat copies
+  the count, min/avg/max latency and a power of two latency histogram of
+  every request to a user buffer, so slow outliers show up.
+
 Further details can be found in the documentation above the function headers.
  */
 
 #include <xeroskernel.h>
+#include <xeroslib.h>
 #include <pcb.h>
 #include <i386.h>
 #include <copyinout.h>
 #include <kbd.h>
+#include <clock.h>
+#include <bitops.h>
 
 /* Syscall dispatches */
+static void dispatch_syscall(syscall_request_id_t request);
 static void timer_handler(void);
+static void update_timer_mode(void);
+static void oneshot_expired(void);
+static void arm_oneshot(unsigned long long deadline);
 static void keyboard_handler(void);
 static int dispatch_syscall_create(void);
 static int dispatch_syscall_kill(void);
@@ -23,24 +63,74 @@ static void dispatch_syscall_wait(void);
 static void dispatch_syscall_puts(void);
 static void dispatch_syscall_send(void);
 static void dispatch_syscall_recv(void);
+static void dispatch_syscall_post(void);
+static void dispatch_syscall_mbox_recv(void);
 static void dispatch_syscall_sleep(void);
+static void dispatch_syscall_sleep_us(void);
 static int dispatch_syscall_getcputimes(void);
 static int dispatch_syscall_sighandler(void);
 static void dispatch_syscall_sigreturn(void);
+static int dispatch_syscall_sigmask(void);
+static int dispatch_syscall_sigqueue(void);
+static void dispatch_syscall_sigwait(void);
 static void dispatch_syscall_open(void);
 static void dispatch_syscall_close(void);
 static void dispatch_syscall_write(void);
 static void dispatch_syscall_read(void);
+static void dispatch_syscall_writev(void);
+static void dispatch_syscall_readv(void);
+static int copy_usr_iovec(iovec_t *iov, const iovec_t *usr_iov, int iovcnt);
 static void dispatch_syscall_ioctl(void);
+static int dispatch_syscall_setprio(void);
+static int dispatch_syscall_getprio(void);
+static int dispatch_syscall_setquantum(void);
+static int dispatch_syscall_ring_register(void);
+static void dispatch_syscall_ring_submit(void);
+static int ring_request_allowed(syscall_request_id_t request);
+static int dispatch_syscall_stat(void);
+static int dispatch_syscall_gettime_ns(void);
+static void record_request(syscall_request_id_t request,
+                           unsigned long cycles);
+static unsigned long average_cycles(unsigned long long total,
+                                    unsigned long count);
 
 
 static proc_ctrl_block_t *currproc;
 
+typedef enum {
+    TIMER_MODE_PERIODIC = 0,
+    // a one-shot is armed for g_oneshot_ticks ticks
+    TIMER_MODE_ONESHOT,
+    // the one-shot went off, and the PIT is not counting towards anything
+    TIMER_MODE_EXPIRED,
+    // a one-shot is armed for g_short_deadline, before the next tick,
+    // or went off if g_short_deadline is 0
+    TIMER_MODE_SHORT,
+    // a one-shot is armed for the next tick, after short sleepers
+    TIMER_MODE_TICK
+} timer_mode_t;
+
+static timer_mode_t g_timer_mode = TIMER_MODE_PERIODIC;
+static int g_oneshot_ticks;
+static unsigned long long g_short_deadline;
+static unsigned int g_avoided_timer_ints;
+
+typedef struct request_stat {
+    unsigned long count;
+    unsigned long min_cycles;
+    unsigned long max_cycles;
+    unsigned long long total_cycles;
+    unsigned long histogram[SYSSTAT_HIST_BUCKETS];
+} request_stat_t;
+
+static request_stat_t g_request_stats[NUM_REQUEST_IDS];
+
 /**
  * Initializes the dispatcher
  */
 void dispinit(void) {
     pcb_table_init();
+    sleep_init();
 }
 
 /**
@@ -54,9 +144,13 @@ void dispinit(void) {
 void dispatch(funcptr root_proc) {
     create(root_proc, DEFAULT_STACK_SIZE);
     currproc = get_next_proc();
+    unsigned long long exit_time = rdtsc();
 
     while(1) {
         syscall_request_id_t request = ctsw_contextswitch(currproc);
+        unsigned long long start = rdtsc();
+        proc_ctrl_block_t *proc = currproc;
+        charge_proc_cycles(proc, CPU_TIME_USER, start - exit_time);
 
         switch(request) {
 
@@ -68,84 +162,171 @@ void dispatch(funcptr root_proc) {
             keyboard_handler();
             break;
 
-        case SYSCALL_CREATE:
-            currproc->ret = dispatch_syscall_create();
-            break;
+        default:
+            dispatch_syscall(request);
+        }
+
+        record_request(request, (unsigned long)(rdtsc() - start));
+        update_timer_mode();
+
+        // choosing the next proc is part of handling this entry
+        exit_time = rdtsc();
+        charge_proc_cycles(proc, (request == TIMER_INT ||
+                                  request == KEYBOARD_INT) ?
+                           CPU_TIME_INTR : CPU_TIME_KERNEL,
+                           exit_time - start);
+    }
+}
+
+/**
+ * Runs a syscall for currproc, with its arguments in currproc->args.
+ * The syscall's result is left in currproc->ret. If the syscall blocks,
+ * or otherwise gives up the cpu, currproc is changed to the next proc to run.
+ * @param request - the syscall to run
+ */
+static void dispatch_syscall(syscall_request_id_t request) {
+    switch(request) {
+
+    case SYSCALL_CREATE:
+        currproc->ret = dispatch_syscall_create();
+        break;
 
-        case SYSCALL_YIELD:
+    case SYSCALL_YIELD:
+        // usually turned around by ctsw already if nothing else would run
+        if (ready_proc_waiting(currproc)) {
             add_pcb_to_queue(currproc, PROC_STATE_READY);
             currproc = get_next_proc();
-            break;
+        }
+        break;
 
-        case SYSCALL_STOP:
-            cleanup_proc(currproc);
-            currproc = get_next_proc();
-            break;
+    case SYSCALL_STOP:
+        cleanup_proc(currproc);
+        currproc = get_next_proc();
+        break;
 
-        case SYSCALL_GETPID:
-            currproc->ret = currproc->pid;
-            break;
+    case SYSCALL_GETPID:
+        currproc->ret = currproc->pid;
+        break;
 
-        case SYSCALL_KILL:
-            currproc->ret = dispatch_syscall_kill();
-            break;
+    case SYSCALL_KILL:
+        currproc->ret = dispatch_syscall_kill();
+        break;
 
-        case SYSCALL_WAIT:
-            dispatch_syscall_wait();
-            break;
+    case SYSCALL_WAIT:
+        dispatch_syscall_wait();
+        break;
 
-        case SYSCALL_PUTS:
-            dispatch_syscall_puts();
-            break;
+    case SYSCALL_PUTS:
+        dispatch_syscall_puts();
+        break;
 
-        case SYSCALL_SEND:
-            dispatch_syscall_send();
-            break;
+    case SYSCALL_SEND:
+        dispatch_syscall_send();
+        break;
 
-        case SYSCALL_RECV:
-            dispatch_syscall_recv();
-            break;
+    case SYSCALL_RECV:
+        dispatch_syscall_recv();
+        break;
 
-        case SYSCALL_SLEEP:
-            dispatch_syscall_sleep();
-            break;
+    case SYSCALL_POST:
+        dispatch_syscall_post();
+        break;
 
-        case SYSCALL_CPUTIMES:
-            currproc->ret = dispatch_syscall_getcputimes();
-            break;
+    case SYSCALL_MBOX_RECV:
+        dispatch_syscall_mbox_recv();
+        break;
 
-        case SYSCALL_SIGHANDLER:
-            currproc->ret = dispatch_syscall_sighandler();
-            break;
+    case SYSCALL_SLEEP:
+        dispatch_syscall_sleep();
+        break;
 
-        case SYSCALL_SIGRETURN:
-            dispatch_syscall_sigreturn();
-            break;
-        
-        case SYSCALL_OPEN:
-            dispatch_syscall_open();
-            break;
-            
-        case SYSCALL_CLOSE:
-            dispatch_syscall_close();
-            break;
-            
-        case SYSCALL_WRITE:
-            dispatch_syscall_write();
-            break;
+    case SYSCALL_CPUTIMES:
+        currproc->ret = dispatch_syscall_getcputimes();
+        break;
+
+    case SYSCALL_SIGHANDLER:
+        currproc->ret = dispatch_syscall_sighandler();
+        break;
+
+    case SYSCALL_SIGRETURN:
+        dispatch_syscall_sigreturn();
+        break;
+
+    case SYSCALL_SIGMASK:
+        currproc->ret = dispatch_syscall_sigmask();
+        break;
+
+    case SYSCALL_SIGQUEUE:
+        currproc->ret = dispatch_syscall_sigqueue();
+        break;
+
+    case SYSCALL_SIGWAIT:
+        dispatch_syscall_sigwait();
+        break;
+    
+    case SYSCALL_OPEN:
+        dispatch_syscall_open();
+        break;
         
-        case SYSCALL_READ:
-            dispatch_syscall_read();
-            break;
+    case SYSCALL_CLOSE:
+        dispatch_syscall_close();
+        break;
         
-        case SYSCALL_IOCTL:
-            dispatch_syscall_ioctl();
-            break;
+    case SYSCALL_WRITE:
+        dispatch_syscall_write();
+        break;
+    
+    case SYSCALL_READ:
+        dispatch_syscall_read();
+        break;
 
-        default:
-            DEBUG("Unknown syscall request: %d\n", request);
-            ASSERT(0);
-        }
+    case SYSCALL_WRITEV:
+        dispatch_syscall_writev();
+        break;
+
+    case SYSCALL_READV:
+        dispatch_syscall_readv();
+        break;
+    
+    case SYSCALL_IOCTL:
+        dispatch_syscall_ioctl();
+        break;
+
+    case SYSCALL_SETPRIO:
+        currproc->ret = dispatch_syscall_setprio();
+        break;
+
+    case SYSCALL_GETPRIO:
+        currproc->ret = dispatch_syscall_getprio();
+        break;
+
+    case SYSCALL_SETQUANTUM:
+        currproc->ret = dispatch_syscall_setquantum();
+        break;
+
+    case SYSCALL_RING_REGISTER:
+        currproc->ret = dispatch_syscall_ring_register();
+        break;
+
+    case SYSCALL_RING_SUBMIT:
+        dispatch_syscall_ring_submit();
+        break;
+
+    case SYSCALL_STAT:
+        currproc->ret = dispatch_syscall_stat();
+        break;
+
+    case SYSCALL_GETTIME_NS:
+        currproc->ret = dispatch_syscall_gettime_ns();
+        break;
+
+    case SYSCALL_SLEEP_US:
+        dispatch_syscall_sleep_us();
+        break;
+
+    default:
+        DEBUG("Unknown syscall request: %d\n", request);
+        ASSERT(0);
     }
 }
 
@@ -298,6 +479,49 @@ static void dispatch_syscall_recv(void) {
     }
 }
 
+/**
+ * Handler for the syspost syscall
+ */
+static void dispatch_syscall_post(void) {
+    int dest_pid = (int)currproc->args[0];
+    void *buffer = (void*)currproc->args[1];
+    unsigned long len = (unsigned long)currproc->args[2];
+
+    if (len <= 0 || len > MBOX_MSG_SIZE || verify_usrptr(buffer, len) != OK) {
+        currproc->ret = SYSERR_OTHER;
+        return;
+    }
+
+    proc_ctrl_block_t *destproc = pid_to_proc(dest_pid);
+    if (destproc == NULL) {
+        currproc->ret = SYSPID_DNE;
+        return;
+    }
+
+    currproc->ret = post(currproc, destproc, buffer, len);
+}
+
+/**
+ * Handler for the sysmbox_recv syscall
+ */
+static void dispatch_syscall_mbox_recv(void) {
+    int *from_pid = (int*)currproc->args[0];
+    void *buffer = (void*)currproc->args[1];
+    unsigned long len = (unsigned long)currproc->args[2];
+
+    if (verify_usrptr(from_pid, sizeof(int)) != OK ||
+        len <= 0 || verify_usrptr(buffer, len) != OK) {
+        currproc->ret = SYSERR_OTHER;
+        return;
+    }
+
+    currproc->ret = mbox_recv(currproc, from_pid, buffer, len);
+    if (currproc->ret == BLOCKERR) {
+        currproc->curr_state = PROC_STATE_BLOCKED;
+        currproc = get_next_proc();
+    }
+}
+
 /**
  * Handler for the syssleep syscall
  */
@@ -311,17 +535,208 @@ static void dispatch_syscall_sleep(void) {
     currproc = get_next_proc();
 }
 
+/**
+ * Handler for the syssleep_us syscall
+ */
+static void dispatch_syscall_sleep_us(void) {
+    unsigned int microseconds = currproc->args[0];
+    if (microseconds == 0) {
+        return;
+    }
+
+    sleep_us(currproc, microseconds);
+    currproc = get_next_proc();
+}
+
 /**
  * Handler for timer events
  */
 static void timer_handler(void) {
-    currproc->cpu_time++;
-    tick();
-    add_pcb_to_queue(currproc, PROC_STATE_READY);
-    currproc = get_next_proc();
+    int ticked = 0;
+
+    if (g_timer_mode == TIMER_MODE_ONESHOT) {
+        oneshot_expired();
+    } else if (g_timer_mode == TIMER_MODE_SHORT) {
+        // only a short sleeper is due, this is not a tick
+        g_short_deadline = 0;
+    } else {
+        // the tick displaced by short sleepers, periodic ticks resume from it
+        if (g_timer_mode == TIMER_MODE_TICK) {
+            initPIT(1000 / TICK_LENGTH_IN_MS);
+            g_timer_mode = TIMER_MODE_PERIODIC;
+        }
+
+        clock_mark_tick();
+        charge_proc_tick(currproc);
+        tick();
+        ticked = 1;
+    }
+    expire_short_sleepers();
+
+    // the running proc keeps the cpu until its quantum, counted in ticks,
+    // is used up. Other wakeups only preempt it for a higher priority proc.
+    if (ticked ? quantum_expired(currproc) : higher_priority_ready(currproc)) {
+        add_pcb_to_queue(currproc, PROC_STATE_READY);
+        currproc = get_next_proc();
+    }
     end_of_intr();
 }
 
+/**
+ * Switches the timer between periodic and one-shot mode, after every event.
+ * Only the idle proc runs with the timer in tickless one-shot mode, and only
+ * while there are no short sleepers. Short sleepers due before the next
+ * tick get a one-shot of their own.
+ */
+static void update_timer_mode(void) {
+    // an interrupt other than the timer's may have readied a proc
+    if (currproc == get_idleproc() &&
+        get_pcb_queue_head(PROC_STATE_READY) != NULL) {
+        add_pcb_to_queue(currproc, PROC_STATE_READY);
+        currproc = get_next_proc();
+    }
+
+    unsigned long long deadline;
+    int short_sleepers = next_short_deadline(&deadline);
+
+    if (currproc == get_idleproc() && !short_sleepers) {
+        if (g_timer_mode == TIMER_MODE_ONESHOT) {
+            return;
+        }
+
+        // with nothing sleeping, ask for a second, the PIT can't wait that long
+        int ticks = ticks_until_wake();
+        if (ticks < 0) {
+            ticks = 1000 / TICK_LENGTH_IN_MS;
+        }
+
+        g_oneshot_ticks = oneshotPIT(ticks);
+        if (g_oneshot_ticks > 0) {
+            g_timer_mode = TIMER_MODE_ONESHOT;
+        }
+        return;
+    }
+
+    if (g_timer_mode == TIMER_MODE_ONESHOT ||
+        g_timer_mode == TIMER_MODE_EXPIRED) {
+        // woken early, count the whole ticks that did pass
+        int elapsed = 0;
+        if (g_timer_mode == TIMER_MODE_ONESHOT) {
+            elapsed = MIN(oneshotElapsedPIT(), g_oneshot_ticks);
+        }
+
+        // mark the tick before advancing, so sleepers still pending are
+        // re-filed against the restarted tick, not the one before idle
+        initPIT(1000 / TICK_LENGTH_IN_MS);
+        clock_mark_tick();
+
+        if (g_timer_mode == TIMER_MODE_ONESHOT) {
+            for (int i = 0; i < elapsed; i++) {
+                charge_proc_tick(get_idleproc());
+            }
+            advance_ticks(elapsed);
+            g_avoided_timer_ints += elapsed;
+        }
+        g_timer_mode = TIMER_MODE_PERIODIC;
+    }
+
+    if (short_sleepers && deadline < clock_next_tick()) {
+        if (g_timer_mode != TIMER_MODE_SHORT || deadline != g_short_deadline) {
+            arm_oneshot(deadline);
+            g_short_deadline = deadline;
+            g_timer_mode = TIMER_MODE_SHORT;
+        }
+    } else if (g_timer_mode == TIMER_MODE_SHORT) {
+        // nothing else is due before the tick, so time the tick itself
+        arm_oneshot(clock_next_tick());
+        g_timer_mode = TIMER_MODE_TICK;
+    }
+}
+
+/**
+ * Arms a one-shot timer interrupt for a TSC deadline,
+ * which must be less than a tick away
+ * @param deadline - TSC value to go off at, immediately if it has passed
+ */
+static void arm_oneshot(unsigned long long deadline) {
+    unsigned long long now = rdtsc();
+    oneshotCountPIT(deadline > now ? clock_cycles_to_pit(deadline - now) : 1);
+}
+
+/**
+ * Accounts for the time covered by a one-shot timer interrupt,
+ * as if every tick of it had gone off.
+ */
+static void oneshot_expired(void) {
+    ASSERT_EQUAL(currproc, get_idleproc());
+
+    clock_mark_tick();
+    for (int i = 0; i < g_oneshot_ticks; i++) {
+        charge_proc_tick(currproc);
+    }
+    advance_ticks(g_oneshot_ticks);
+
+    g_avoided_timer_ints += g_oneshot_ticks - 1;
+    g_timer_mode = TIMER_MODE_EXPIRED;
+}
+
+/**
+ * Returns the number of timer interrupts tickless idle has avoided
+ * @return timer interrupts avoided since boot
+ */
+unsigned int get_avoided_timer_ints(void) {
+    return g_avoided_timer_ints;
+}
+
+/**
+ * Records that a request was handled
+ * @param request - the request
+ * @param cycles - cpu cycles spent handling the request
+ */
+static void record_request(syscall_request_id_t request,
+                           unsigned long cycles) {
+    ASSERT(request >= 0 && request < NUM_REQUEST_IDS);
+    request_stat_t *stat = &g_request_stats[request];
+
+    if (stat->count == 0 || cycles < stat->min_cycles) {
+        stat->min_cycles = cycles;
+    }
+    stat->max_cycles = MAX(stat->max_cycles, cycles);
+    stat->total_cycles += cycles;
+    stat->count++;
+
+    int bucket = (cycles != 0 ? bit_scan_reverse(cycles) : 0) -
+                 SYSSTAT_HIST_MIN_LOG2;
+    bucket = MIN(MAX(bucket, 0), SYSSTAT_HIST_BUCKETS - 1);
+    stat->histogram[bucket]++;
+}
+
+/**
+ * Computes total / count, without 64 bit division, which the kernel lacks.
+ * @param total - sum of count latencies
+ * @param count - number of latencies
+ * @return the average latency, 0 if count is 0
+ */
+static unsigned long average_cycles(unsigned long long total,
+                                    unsigned long count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    // scale both down until the total fits in 32 bits,
+    // so the average loses precision only on huge totals
+    while (total >> 32) {
+        total >>= 1;
+        count >>= 1;
+    }
+
+    if (count == 0) {
+        return (unsigned long)-1;
+    }
+
+    return (unsigned long)total / count;
+}
+
 /**
  * Handler for keyboard events
  */
@@ -336,11 +751,13 @@ static void keyboard_handler(void) {
  */
 static int dispatch_syscall_getcputimes(void) {
     processStatuses *ps = (processStatuses*)currproc->args[0];
-    if (verify_usrptr(ps, sizeof(processStatuses)) != OK) {
+    int cursor = (int)currproc->args[1];
+    if (verify_usrptr(ps, sizeof(processStatuses)) != OK ||
+        cursor < 0 || cursor > PCB_MAX_PROCS) {
         return -1;
     }
 
-    return get_all_proc_info(ps);
+    return get_all_proc_info(ps, cursor);
 }
 
 /**
@@ -389,6 +806,69 @@ static void dispatch_syscall_sigreturn(void) {
     currproc->signals_enabled = 1;
 }
 
+/**
+ * Handler for syssigmask
+ * @return 0 on success, SYSERR_OTHER if old_mask is invalid
+ */
+static int dispatch_syscall_sigmask(void) {
+    unsigned int mask = (unsigned int)currproc->args[0];
+    unsigned int *old_mask = (unsigned int*)currproc->args[1];
+
+    if (old_mask != NULL &&
+        verify_usrptr(old_mask, sizeof(unsigned int)) != OK) {
+        return SYSERR_OTHER;
+    }
+
+    if (old_mask != NULL) {
+        *old_mask = currproc->signals_masked;
+    }
+
+    // newly unmasked pending signals are delivered as the proc resumes
+    currproc->signals_masked = mask;
+    return 0;
+}
+
+/**
+ * Handler for syssigqueue
+ * @return 0 on success, error code on failure - see syssigqueue
+ */
+static int dispatch_syscall_sigqueue(void) {
+    int pid = currproc->args[0];
+    int signal = currproc->args[1];
+    unsigned long value = currproc->args[2];
+
+    proc_ctrl_block_t* proc = pid_to_proc(pid);
+    if (proc == NULL) {
+        return SYSKILL_TARGET_DNE;
+    }
+
+    return queue_proc_signal(proc, signal, value);
+}
+
+/**
+ * Handler for syssigwait. Takes the highest pending signal in the set, or
+ * blocks until one is sent, when set_proc_signal or queue_proc_signal
+ * hands it over.
+ */
+static void dispatch_syscall_sigwait(void) {
+    unsigned int set = (unsigned int)currproc->args[0];
+    unsigned long *value = (unsigned long*)currproc->args[1];
+
+    if (set == 0 || (value != NULL &&
+        verify_usrptr(value, sizeof(unsigned long)) != OK)) {
+        currproc->ret = SYSERR_OTHER;
+        return;
+    }
+
+    currproc->ret = take_highest_signal(currproc, set, value);
+    if (currproc->ret < 0) {
+        currproc->curr_state = PROC_STATE_BLOCKED;
+        currproc->blocking_queue_name = SIGWAIT;
+        currproc->blocking_proc = NULL;
+        currproc = get_next_proc();
+    }
+}
+
 /**
  * Handler for sysopen
  * @return file descriptor on success, -1 on error
@@ -421,6 +901,7 @@ static void dispatch_syscall_write(void) {
     int result = verify_usrptr(buf, buflen);
     if (result != OK) {
         currproc->ret = SYSERR;
+        return;
     }
     
     currproc->ret = di_write(currproc, fd, buf, buflen);
@@ -451,6 +932,87 @@ static void dispatch_syscall_read(void) {
     }
 }
 
+/**
+ * Handler for syswritev
+ * @return number of bytes written on success, -1 on failure
+ */
+static void dispatch_syscall_writev(void) {
+    int fd = (int)currproc->args[0];
+    const iovec_t *usr_iov = (const iovec_t*)currproc->args[1];
+    int iovcnt = (int)currproc->args[2];
+    iovec_t iov[IOV_MAX];
+
+    if (copy_usr_iovec(iov, usr_iov, iovcnt) != OK) {
+        currproc->ret = SYSERR;
+        return;
+    }
+
+    currproc->ret = di_writev(currproc, fd, iov, iovcnt);
+}
+
+/**
+ * Handler for sysreadv
+ * @return number of bytes read on success, -1 on failure
+ */
+static void dispatch_syscall_readv(void) {
+    int fd = (int)currproc->args[0];
+    const iovec_t *usr_iov = (const iovec_t*)currproc->args[1];
+    int iovcnt = (int)currproc->args[2];
+    iovec_t iov[IOV_MAX];
+
+    if (copy_usr_iovec(iov, usr_iov, iovcnt) != OK) {
+        currproc->ret = SYSERR;
+        return;
+    }
+
+    currproc->ret = di_readv(currproc, fd, iov, iovcnt);
+
+    if (currproc->ret == BLOCKERR) {
+        currproc->curr_state = PROC_STATE_BLOCKED;
+        currproc->blocking_queue_name = DEVICE;
+        currproc = get_next_proc();
+    }
+}
+
+/**
+ * Copies a user's iovec array into the kernel, so it can not change while
+ * it is used, and checks each of its buffers
+ * @param iov - array of IOV_MAX to copy into
+ * @param usr_iov - the user's array
+ * @param iovcnt - number of buffers in usr_iov
+ * @return OK if all of the buffers may be used, EINVAL otherwise
+ */
+static int copy_usr_iovec(iovec_t *iov, const iovec_t *usr_iov, int iovcnt) {
+    if (iovcnt < 0 || iovcnt > IOV_MAX) {
+        return EINVAL;
+    }
+
+    if (iovcnt == 0) {
+        return OK;
+    }
+
+    if (verify_usrptr((void*)usr_iov, iovcnt * sizeof(iovec_t)) != OK) {
+        return EINVAL;
+    }
+    blkcopy(iov, (void*)usr_iov, iovcnt * sizeof(iovec_t));
+
+    int total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len < 0 || iov[i].iov_len > IOV_BYTES_MAX - total) {
+            return EINVAL;
+        }
+
+        if (iov[i].iov_len > 0 &&
+            verify_usrptr(iov[i].iov_base, iov[i].iov_len) != OK) {
+            return EINVAL;
+        }
+
+        total += iov[i].iov_len;
+    }
+
+    return OK;
+}
+
 /**
  * Handler for sysioctl
  * @return 0 on success, -1 on failure
@@ -465,3 +1027,206 @@ static void dispatch_syscall_ioctl(void) {
     currproc->ret = di_ioctl(currproc, fd, command, args);
     return;
 }
+
+/**
+ * Handler for syssetprio
+ * @return 0 on success, error code on failure
+ */
+static int dispatch_syscall_setprio(void) {
+    int pid = (int)currproc->args[0];
+    int priority = (int)currproc->args[1];
+
+    proc_ctrl_block_t *proc = (pid == 0) ? currproc : pid_to_proc(pid);
+    if (proc == NULL) {
+        return SYSPID_DNE;
+    }
+
+    return set_proc_priority(proc, priority);
+}
+
+/**
+ * Handler for sysgetprio
+ * @return the process's current priority, error code on failure
+ */
+static int dispatch_syscall_getprio(void) {
+    int pid = (int)currproc->args[0];
+
+    proc_ctrl_block_t *proc = (pid == 0) ? currproc : pid_to_proc(pid);
+    if (proc == NULL) {
+        return SYSPID_DNE;
+    }
+
+    return proc->priority;
+}
+
+/**
+ * Handler for syssetquantum
+ * @return 0 on success, error code on failure
+ */
+static int dispatch_syscall_setquantum(void) {
+    int pid = (int)currproc->args[0];
+    int ticks = (int)currproc->args[1];
+
+    proc_ctrl_block_t *proc = (pid == 0) ? currproc : pid_to_proc(pid);
+    if (proc == NULL) {
+        return SYSPID_DNE;
+    }
+
+    return set_proc_quantum(proc, ticks);
+}
+
+/**
+ * Handler for sysring_register
+ * @return 0 on success, SYSERR_OTHER if the ring is invalid
+ */
+static int dispatch_syscall_ring_register(void) {
+    syscall_ring_t *ring = (syscall_ring_t*)currproc->args[0];
+
+    // a NULL ring unregisters
+    if (ring != NULL) {
+        if (verify_usrptr(ring, sizeof(syscall_ring_t)) != OK) {
+            return SYSERR_OTHER;
+        }
+
+        ring->head = 0;
+        ring->tail = 0;
+        ring->blocked = -1;
+    }
+
+    currproc->syscall_ring = ring;
+    return 0;
+}
+
+/**
+ * Handler for sysring_submit. Runs entries from the calling process's ring
+ * until it is empty, or an entry blocks.
+ * The result of each entry is stored in the entry.
+ * If an entry blocks, its index is stored in ring->blocked, and its result
+ * will be the return value of the submit.
+ */
+static void dispatch_syscall_ring_submit(void) {
+    proc_ctrl_block_t *proc = currproc;
+    syscall_ring_t *ring = (syscall_ring_t*)proc->args[0];
+
+    if (ring == NULL || ring != proc->syscall_ring ||
+        ring->tail - ring->head > SYSCALL_RING_SIZE) {
+        // nothing blocked, sysring_submit checks this before the result
+        if (ring != NULL &&
+            verify_usrptr(ring, sizeof(syscall_ring_t)) == OK) {
+            ring->blocked = -1;
+        }
+        proc->ret = SYSERR_OTHER;
+        return;
+    }
+
+    // entries are handed to the handlers in place, so keep the process's
+    // own args to restore at the end
+    unsigned long *args = proc->args;
+    int completed = 0;
+
+    ring->blocked = -1;
+    while (ring->head != ring->tail) {
+        int index = ring->head % SYSCALL_RING_SIZE;
+        syscall_ring_entry_t *entry = &ring->entries[index];
+        ring->head++;
+
+        if (!ring_request_allowed(entry->request)) {
+            entry->ret = SYSERR_OTHER;
+            completed++;
+            continue;
+        }
+
+        proc->args = entry->args;
+        dispatch_syscall(entry->request);
+
+        if (currproc != proc) {
+            // the process blocked, this entry completes when it wakes
+            ring->blocked = index;
+            return;
+        }
+
+        entry->ret = proc->ret;
+        completed++;
+    }
+
+    proc->args = args;
+    proc->ret = completed;
+}
+
+/**
+ * Checks whether a syscall may be batched in a syscall ring.
+ * Syscalls which never return, or change how the process returns to user
+ * mode, may not be batched.
+ * @param request - the syscall
+ * @return 1 if the syscall may be batched, 0 otherwise
+ */
+static int ring_request_allowed(syscall_request_id_t request) {
+    switch(request) {
+
+    case SYSCALL_GETPID:
+    case SYSCALL_KILL:
+    case SYSCALL_PUTS:
+    case SYSCALL_SEND:
+    case SYSCALL_RECV:
+    case SYSCALL_POST:
+    case SYSCALL_MBOX_RECV:
+    case SYSCALL_SLEEP:
+    case SYSCALL_SLEEP_US:
+    case SYSCALL_GETTIME_NS:
+    case SYSCALL_WRITE:
+    case SYSCALL_WRITEV:
+    case SYSCALL_SETPRIO:
+    case SYSCALL_GETPRIO:
+    case SYSCALL_SETQUANTUM:
+    case SYSCALL_SIGMASK:
+    case SYSCALL_SIGQUEUE:
+    case SYSCALL_SIGWAIT:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Handler for sysstat
+ * @return number of requests copied, SYSERR_OTHER if the buffer is invalid
+ */
+static int dispatch_syscall_stat(void) {
+    syscallStats *stats = (syscallStats*)currproc->args[0];
+    int reset = (int)currproc->args[1];
+
+    if (verify_usrptr(stats, sizeof(syscallStats)) != OK) {
+        return SYSERR_OTHER;
+    }
+
+    for (int i = 0; i < NUM_REQUEST_IDS; i++) {
+        request_stat_t *stat = &g_request_stats[i];
+        stats->count[i] = stat->count;
+        stats->minCycles[i] = stat->min_cycles;
+        stats->avgCycles[i] = average_cycles(stat->total_cycles, stat->count);
+        stats->maxCycles[i] = stat->max_cycles;
+        blkcopy(stat->histogram, stats->histogram[i], sizeof(stat->histogram));
+    }
+
+    if (reset) {
+        memset(g_request_stats, 0, sizeof(g_request_stats));
+    }
+
+    return NUM_REQUEST_IDS;
+}
+
+/**
+ * Handler for sysgettime_ns
+ * @return 0 on success, SYSERR_OTHER if the buffer is invalid
+ */
+static int dispatch_syscall_gettime_ns(void) {
+    unsigned long long *ns = (unsigned long long*)currproc->args[0];
+
+    if (verify_usrptr(ns, sizeof(unsigned long long)) != OK) {
+        return SYSERR_OTHER;
+    }
+
+    *ns = clock_ns();
+    return 0;
+}
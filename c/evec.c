@@ -89,7 +89,7 @@ void trap(int inum)
          * the global variable fp. What this means is that fp is pointing 
          * to the current frame. 
          */
-	asm("movl	%ebp,fp");
+	asm("movl	%%ebp,%0" : "=r" (fp));
       
 	sp = fp;	/* eflags/CS/eip/ebp/regs/trap#/Xtrap/ebp */
 
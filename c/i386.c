@@ -13,6 +13,9 @@
 
 void enable_irq( unsigned int,  int);
 
+static int		pit_divisor = 0;	/* rate set by initPIT	*/
+static unsigned int	pit_oneshot_count;	/* count of last oneshotPIT */
+
 
 struct sd gdt_copy[NGD] = {
 		/* 0th entry NULL */
@@ -34,15 +37,80 @@ long	initsp;		/* initial SP for init() */
 long    freemem;        /* start of free memory */
 char	*maxaddr;       /* end of memory space */
 
+struct memregion	memregions[MAX_MEM_REGIONS];	/* usable memory */
+int			nmemregions;
+
+/* Left in the boot block by boot/boot/setup.S, which is only overwritten */
+/* once kmeminit hands that memory out				   */
+#define	BOOT_EXT_MEM_K	(*(unsigned short *)0x90002)	/* KB above 1M	*/
+
+#define	EXT_MEM_START	(1024 * 1024)
+
+/* Memory above 1GB is left unused, so every address stays positive as a */
+/* long (see verify_usrptr)						 */
+#define	MEM_LIMIT	0x40000000
+
+/* Used if the BIOS reports nothing usable */
+#define	DEFAULT_NPAGES	1024
+
+static void	add_memregion(unsigned long, unsigned long);
 
 
 /*------------------------------------------------------------------------
- * sizmem - return memory size (in pages)
+ * sizmem - find usable memory, return memory size (in pages)
+ *
+ * Memory is sized from the extended memory size int 0x15 ah=0x88 left in
+ * the boot block, not the E820 map. That is a 16 bit count of KB, so
+ * at most about 64MB is found and anything above it goes unused.
  *------------------------------------------------------------------------
  */
 long sizmem(void)
 {
-        return 1024;
+	unsigned long	end;
+	int		i;
+
+	/* base memory, and the extended memory size from the BIOS */
+	nmemregions = 0;
+	add_memregion(0, HOLESTART);
+	add_memregion(EXT_MEM_START,
+		      EXT_MEM_START + (unsigned long)BOOT_EXT_MEM_K * 1024);
+
+	/* the heap after HOLEEND lives above 1M, so require memory there */
+	end = 0;
+	for (i = 0; i < nmemregions; i++)
+		if (memregions[i].mr_end > end)
+			end = memregions[i].mr_end;
+	if (end <= HOLEEND) {
+		nmemregions = 0;
+		add_memregion(0, HOLESTART);
+		add_memregion(HOLEEND, DEFAULT_NPAGES * NBPG);
+		end = DEFAULT_NPAGES * NBPG;
+	}
+
+	return end / NBPG;
+}
+
+/*------------------------------------------------------------------------
+ * add_memregion - add usable memory to memregions, kept sorted by address
+ *------------------------------------------------------------------------
+ */
+static void add_memregion(unsigned long start, unsigned long end)
+{
+	int	i;
+
+	/* whole pages only, and nothing the kernel cannot map */
+	start = (start + NBPG - 1) & ~(NBPG - 1);
+	end &= ~(NBPG - 1);
+	if (end > MEM_LIMIT)
+		end = MEM_LIMIT;
+	if (start >= end || nmemregions == MAX_MEM_REGIONS)
+		return;
+
+	for (i = nmemregions; i > 0 && memregions[i-1].mr_start > start; i--)
+		memregions[i] = memregions[i-1];
+	memregions[i].mr_start = start;
+	memregions[i].mr_end = end;
+	nmemregions++;
 }
 
 
@@ -114,6 +182,7 @@ void init8259()
  */
 void initPIT( int divisor )
 {
+        pit_divisor = divisor;
         outb( TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT );
         outb( TIMER_1_PORT, TIMER_DIV(divisor) & 0xff );
         outb( TIMER_1_PORT, TIMER_DIV(divisor) >> 8 );
@@ -121,6 +190,82 @@ void initPIT( int divisor )
 }
 
 
+/*------------------------------------------------------------------------
+ * oneshotPIT - program a single interrupt, ticks periods of initPIT's
+ *              rate from now. The counter is only 16 bits, so fewer ticks
+ *              may be programmed than asked for. Returns the number of
+ *              ticks programmed, 0 if initPIT has not been called.
+ *------------------------------------------------------------------------
+ */
+int oneshotPIT( int ticks )
+{
+        unsigned int	count;
+
+        if( pit_divisor == 0 || ticks <= 0 ) {
+            return( 0 );
+        }
+
+        ticks = MIN( ticks, 0xffff / TIMER_DIV(pit_divisor) );
+        count = ticks * TIMER_DIV(pit_divisor);
+
+        oneshotCountPIT( count );
+        pit_oneshot_count = count;
+        return( ticks );
+}
+
+
+/*------------------------------------------------------------------------
+ * oneshotElapsedPIT - whole ticks elapsed since oneshotPIT was called
+ *------------------------------------------------------------------------
+ */
+int oneshotElapsedPIT( void )
+{
+        unsigned int	count;
+
+        if( pit_divisor == 0 ) {
+            return( 0 );
+        }
+
+        count = readPIT();
+
+        /* once it hits 0, the counter wraps and keeps counting down */
+        if( count > pit_oneshot_count ) {
+            count = 0;
+        }
+
+        return( ( pit_oneshot_count - count ) / TIMER_DIV(pit_divisor) );
+}
+
+
+/*------------------------------------------------------------------------
+ * oneshotCountPIT - program a single interrupt, count PIT periods of
+ *                   1/TIMER_FREQ seconds from now, 1 to 0xffff
+ *------------------------------------------------------------------------
+ */
+void oneshotCountPIT( unsigned int count )
+{
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_INTTC | TIMER_16BIT );
+        outb( TIMER_1_PORT, count & 0xff );
+        outb( TIMER_1_PORT, count >> 8 );
+}
+
+
+/*------------------------------------------------------------------------
+ * readPIT - returns the current count of counter 0
+ *------------------------------------------------------------------------
+ */
+unsigned int readPIT( void )
+{
+        unsigned int	count;
+
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_LATCH );
+        count = inb( TIMER_CNTR0 );
+        count |= inb( TIMER_CNTR0 ) << 8;
+
+        return( count );
+}
+
+
 /*------------------------------------------------------------------------
  * setEnabledKbd - enable/disable the keyboard device
  *------------------------------------------------------------------------
@@ -171,6 +316,20 @@ void enable_irq( unsigned int irq, int disable )
 }
 
 
+/*------------------------------------------------------------------------
+ * rdtsc - returns the CPU's time stamp counter, in cycles
+ *------------------------------------------------------------------------
+ */
+unsigned long long rdtsc( void )
+{
+    unsigned long long	tsc;
+
+    __asm __volatile( "rdtsc" : "=A" (tsc) );
+
+    return( tsc );
+}
+
+
 /*------------------------------------------------------------------------
  * getCS - returns current CS selector
  *------------------------------------------------------------------------
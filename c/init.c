@@ -3,6 +3,7 @@
 #include <i386.h>
 #include <xeroskernel.h>
 #include <xeroslib.h>
+#include <clock.h>
 
 #ifdef TESTING
 #include <xerostest.h>
@@ -39,6 +40,15 @@ void initproc( void )				/* The beginning */
 
   kmeminit();
   kprintf("kmem initialized\n");
+
+  kslab_init();
+  kprintf("slab initialized\n");
+
+  stackpool_init();
+  kprintf("stack pool initialized\n");
+
+  clock_init();
+  kprintf("clock initialized, TSC at %d kHz\n", clock_get_khz());
   
   di_init_devtable();
   kprintf("devices initialized\n");
@@ -1,4 +1,30 @@
 /* kbd.c: Keyboard device specific code
+
+Called from outside:
+  kbd_devsw_create() - fills in a device table entry for the keyboard
+  kbd_init(), kbd_open(), kbd_close(), kbd_read(), kbd_readv(),
+  kbd_write(), kbd_ioctl(), kbd_cancel(), kbd_iint(), kbd_oint()
+    - implementations of the devsw functions
+  keyboard_isr() - handles a keyboard interrupt
+
+Note:
+  Characters typed go into a ring buffer, which keyboard_isr fills and
+  reads empty. Its size is a power of two, so its head and tail can count
+  up freely and be masked on use, and the count of characters in it is
+  always head - tail. Only keyboard_isr moves the head and only readers
+  move the tail, so the two sides need no lock between them. When the
+  ring is full further characters are dropped, and counted.
+
+  Readers that find too little in the ring wait in a FIFO queue, and are
+  served in turn, each taking the characters it asked for, so every
+  character goes to exactly one reader. A read completes once the ring
+  holds a line, buflen characters, or as many as it can hold, or at EOF.
+  A sysreadv is one read of its buffers' total length, filling each in
+  turn, so a line spread over several buffers arrives in one wakeup.
+  keyboard_isr only looks at the reader at the head of the queue, so the
+  work per scancode does not grow with the number of readers.
+
+Further details can be found in the documentation above the function headers.
 */
 
 #include <stdarg.h>
@@ -12,44 +38,53 @@
 #define KEYBOARD_PORT_CONTROL_READY_MASK 0x01
 #define KEYBOARD_PORT_DATA_SCANCODE_MASK 0x0FF
 
-typedef struct kbd_task {
-    proc_ctrl_block_t *pcb;
-    void *buf;
+// a read waiting for characters, oldest at the head of the queue, with a
+// copy of the buffers it reads into, buflen bytes in all
+typedef struct kbd_reader {
+    proc_ctrl_block_t *proc;
     int buflen;
-    int i;
-    int waiting_on_read;
-} kbd_task_t;
-// PID_based task list, using refcount to indicate when nobody is waiting
-#define KBD_TASK_LIST_SIZE (PCB_TABLE_SIZE)
-static kbd_task_t g_kbd_task_list[KBD_TASK_LIST_SIZE];
-static int g_kbd_task_refcount = 0;
+    int iovcnt;
+    struct kbd_reader *next;
+    iovec_t iov[];
+} kbd_reader_t;
+static kbd_reader_t *g_kbd_readers_head = NULL;
+static kbd_reader_t *g_kbd_readers_tail = NULL;
 
 typedef struct kbd_dvioblk {
     int orig_echo_flag;
 } kbd_dvioblk_t;
 
 static int kbd_ioctl_set_eof(void *args);
+static int kbd_ioctl_set_buffer_size(void *args);
 // Only 1 keyboard type is allowed to be open at a time
 static int g_kbd_refcount = 0;
 static int g_kbd_current_type = 0;
 static int g_kbd_done = 0;
 
-static void keyboard_flush_buffer(void);
 static char keyboard_process_scancode(int data);
-static void keyboard_unblock_proc(kbd_task_t *task);
-static void keyboard_process_char(char c);
 static void keyboard_handle_eof(void);
+static void keyboard_serve_readers(void);
+static int keyboard_read_ready(int buflen);
+static int keyboard_read_iov(proc_ctrl_block_t *proc,
+                             const iovec_t *iov, int iovcnt);
+static int keyboard_buffer_take(const iovec_t *iov, int iovcnt);
+static void keyboard_buffer_reset(void);
 
 #define KEYBOARD_STATE_SHIFT_BIT 0
 #define KEYBOARD_STATE_CTRL_BIT 1
 #define KEYBOARD_STATE_CAPLOCK_BIT 2
 static int g_keyboard_keystate_flag = 0;
 
-// Circular buffer implementation, 1 index is "wasted" to indicate full buffer
-#define KEYBOARD_BUFFER_SIZE (4 + 1)
-static char g_keyboard_buffer[KEYBOARD_BUFFER_SIZE] = {0};
-static int g_keyboard_buffer_head = 0;
-static int g_keyboard_buffer_tail = 0;
+// Ring buffer of typed characters, see the note above. The newline counts
+// are split the same way as head and tail, so a line is waiting whenever
+// they differ.
+static char *g_keyboard_buffer = NULL;
+static unsigned int g_keyboard_buffer_size = KBD_BUFFER_SIZE_DEFAULT;
+static volatile unsigned int g_keyboard_buffer_head = 0;
+static volatile unsigned int g_keyboard_buffer_tail = 0;
+static volatile unsigned int g_keyboard_newlines_in = 0;
+static volatile unsigned int g_keyboard_newlines_out = 0;
+static unsigned int g_keyboard_dropped = 0;
 static char g_keyboard_eof;
 static char g_keyboard_echo_flag; // 1 for on, 0 for off
 
@@ -66,13 +101,16 @@ void kbd_devsw_create(devsw_t *entry, int echo_flag) {
     entry->dvopen = &kbd_open;
     entry->dvclose = &kbd_close;
     entry->dvread = &kbd_read;
+    entry->dvreadv = &kbd_readv;
+    entry->dvwritev = NULL;
     entry->dvwrite = &kbd_write;
     entry->dvioctl = &kbd_ioctl;
+    entry->dvcancel = &kbd_cancel;
     entry->dviint = &kbd_iint;
     entry->dvoint = &kbd_oint;
     entry->dvminor = echo_flag;
-    // Note: this kmalloc will intentionally never be kfree'd
-    entry->dvioblk = (kbd_dvioblk_t*)kmalloc(sizeof(kbd_dvioblk_t));
+    // Note: this allocation will intentionally never be freed
+    entry->dvioblk = (kbd_dvioblk_t*)kslab_alloc(sizeof(kbd_dvioblk_t));
     ASSERT(entry->dvioblk != NULL);
     ((kbd_dvioblk_t*)entry->dvioblk)->orig_echo_flag = echo_flag;
 }
@@ -82,17 +120,18 @@ void kbd_devsw_create(devsw_t *entry, int echo_flag) {
  ******************************************************************************/
 
 int kbd_init(void) {
-    int i;
-    
     g_kbd_refcount = 0;
     g_kbd_done = 0;
-    g_keyboard_buffer_head = 0;
-    g_keyboard_buffer_tail = 0;
-    g_kbd_task_refcount = 0;
-    
-    for (i = 0; i < KBD_TASK_LIST_SIZE; i++) {
-        g_kbd_task_list[i].waiting_on_read = 0;
+    g_kbd_readers_head = NULL;
+    g_kbd_readers_tail = NULL;
+    
+    // both keyboard devices share the one buffer
+    // Note: this allocation will intentionally never be freed
+    if (g_keyboard_buffer == NULL) {
+        g_keyboard_buffer = kmalloc(g_keyboard_buffer_size);
+        ASSERT(g_keyboard_buffer != NULL);
     }
+    keyboard_buffer_reset();
     
     // Read data from the ports, in case some interrupts triggered in the past
     inb(KEYBOARD_PORT_DATA);
@@ -101,6 +140,9 @@ int kbd_init(void) {
 }
 
 int kbd_open(proc_ctrl_block_t *proc, void *dvioblk) {
+    // unused
+    (void)proc;
+    
     int echo_flag = ((kbd_dvioblk_t*)dvioblk)->orig_echo_flag;
     
     if (g_kbd_refcount > 0) {
@@ -112,22 +154,24 @@ int kbd_open(proc_ctrl_block_t *proc, void *dvioblk) {
         return 0;
     }
     
+    // nobody has the keyboard open, so nobody can be waiting on it
+    ASSERT_EQUAL(g_kbd_readers_head, NULL);
+    
     g_kbd_refcount = 1;
     g_kbd_current_type = echo_flag;
     g_kbd_done = 0;
-    g_keyboard_buffer_head = 0;
-    g_keyboard_buffer_tail = 0;
+    keyboard_buffer_reset();
     g_keyboard_keystate_flag = 0;
     g_keyboard_eof = KBD_DEFAULT_EOF;
     g_keyboard_echo_flag = echo_flag;
     
-    ASSERT(g_kbd_task_list[proc->pid % KBD_TASK_LIST_SIZE].waiting_on_read == 0);
     setEnabledKbd(1);
     return 0;
 }
 
 int kbd_close(proc_ctrl_block_t *proc, void *dvioblk) {
     // unused
+    (void)proc;
     (void)dvioblk;
     
     if (g_kbd_refcount <= 0) {
@@ -139,41 +183,23 @@ int kbd_close(proc_ctrl_block_t *proc, void *dvioblk) {
         setEnabledKbd(0);
     }
     
-    if (g_kbd_task_list[proc->pid % KBD_TASK_LIST_SIZE].waiting_on_read) {
-        g_kbd_task_refcount--;
-    }
-    
-    g_kbd_task_list[proc->pid % KBD_TASK_LIST_SIZE].waiting_on_read = 0;
     return 0;
 }
 
 int kbd_read(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen) {
     // unused
-    (void)proc;
     (void)dvioblk;
     
-    kbd_task_t *task = &g_kbd_task_list[proc->pid % KBD_TASK_LIST_SIZE];
-    g_kbd_task_refcount++;
-    
-    task->pcb = proc;
-    task->buf = buf;
-    task->i = 0;
-    task->buflen = buflen;
-    task->waiting_on_read = 1;
-    
-    keyboard_flush_buffer();
-    if (task->i == buflen) {
-        return buflen;
-    }
-    
-    if (g_kbd_done) {
-        // EOF was encountered. We have to do this check
-        // here in case our buffer has a couple of stray \n characters,
-        // which would require multiple reads to fully flush
-        return task->i;
-    }
+    iovec_t iov = { buf, buflen };
+    return keyboard_read_iov(proc, &iov, 1);
+}
+
+int kbd_readv(proc_ctrl_block_t *proc, void *dvioblk,
+              const iovec_t *iov, int iovcnt) {
+    // unused
+    (void)dvioblk;
     
-    return BLOCKERR;
+    return keyboard_read_iov(proc, iov, iovcnt);
 }
 
 int kbd_write(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen) {
@@ -209,11 +235,58 @@ int kbd_ioctl(proc_ctrl_block_t *proc, void *dvioblk, unsigned long command, voi
         case KEYBOARD_IOCTL_GET_ECHO:
             return g_keyboard_echo_flag;
             
+        case KEYBOARD_IOCTL_SET_BUFFER_SIZE:
+            return kbd_ioctl_set_buffer_size(args);
+            
+        case KEYBOARD_IOCTL_GET_BUFFER_SIZE:
+            return (int)g_keyboard_buffer_size;
+            
+        case KEYBOARD_IOCTL_GET_DROPPED:
+            return (int)g_keyboard_dropped;
+            
         default:
             return SYSERR;
     }
 }
 
+/**
+ * Abandons a read a process is blocked on, because it was signalled or
+ * killed. Its characters stay in the buffer for the next reader.
+ * @param proc - process blocked on a keyboard read
+ * @param dvioblk - unused
+ */
+void kbd_cancel(proc_ctrl_block_t *proc, void *dvioblk) {
+    // unused
+    (void)dvioblk;
+    
+    kbd_reader_t *prev = NULL;
+    kbd_reader_t *reader = g_kbd_readers_head;
+    
+    while (reader != NULL && reader->proc != proc) {
+        prev = reader;
+        reader = reader->next;
+    }
+    
+    if (reader == NULL) {
+        return;
+    }
+    
+    if (prev == NULL) {
+        g_kbd_readers_head = reader->next;
+    } else {
+        prev->next = reader->next;
+    }
+    
+    if (g_kbd_readers_tail == reader) {
+        g_kbd_readers_tail = prev;
+    }
+    
+    kslab_free(reader);
+    
+    // the reader behind it may be satisfied by what is already buffered
+    keyboard_serve_readers();
+}
+
 int kbd_iint(void) {
     return -1;
 }
@@ -242,6 +315,106 @@ static int kbd_ioctl_set_eof(void *args) {
     return 0;
 }
 
+/**
+ * kbd_ioctl_set_buffer_size
+ * Helper function for resizing the buffer of typed characters. Characters
+ * already in it are kept.
+ * @param args - va_list passed from userspace, holding the new size, a
+ *               power of two from KBD_BUFFER_SIZE_MIN to KBD_BUFFER_SIZE_MAX
+ * @return 0 on success, SYSERR if the size is invalid, too small to hold
+ *         the characters already buffered, or can not be allocated
+ */
+static int kbd_ioctl_set_buffer_size(void *args) {
+    va_list v;
+    
+    if (args == NULL) {
+        return SYSERR;
+    }
+    
+    v = (va_list)args;
+    int size = va_arg(v, int);
+    
+    if (size < KBD_BUFFER_SIZE_MIN || size > KBD_BUFFER_SIZE_MAX ||
+        (size & (size - 1)) != 0) {
+        return SYSERR;
+    }
+    
+    unsigned int count = g_keyboard_buffer_head - g_keyboard_buffer_tail;
+    if (count > (unsigned int)size) {
+        return SYSERR;
+    }
+    
+    char *buffer = kmalloc(size);
+    if (buffer == NULL) {
+        return SYSERR;
+    }
+    
+    unsigned int mask = g_keyboard_buffer_size - 1;
+    for (unsigned int i = 0; i < count; i++) {
+        buffer[i] = g_keyboard_buffer[(g_keyboard_buffer_tail + i) & mask];
+    }
+    
+    kfree(g_keyboard_buffer);
+    g_keyboard_buffer = buffer;
+    g_keyboard_buffer_size = size;
+    g_keyboard_buffer_tail = 0;
+    g_keyboard_buffer_head = count;
+    
+    // a smaller buffer may now be as full as it gets
+    keyboard_serve_readers();
+    return 0;
+}
+
+/**
+ * keyboard_read_iov
+ * Reads into a reader's buffers now if the characters buffered allow it,
+ * or queues the reader until they do
+ * @param proc - process reading
+ * @param iov - buffers to read into, copied if the reader is queued
+ * @param iovcnt - number of buffers in iov, at most IOV_MAX
+ * @return number of characters read, BLOCKERR if proc must wait for more,
+ *         or SYSERR if it can not be queued
+ */
+static int keyboard_read_iov(proc_ctrl_block_t *proc,
+                             const iovec_t *iov, int iovcnt) {
+    ASSERT(iovcnt >= 0 && iovcnt <= IOV_MAX);
+    
+    int buflen = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        buflen += iov[i].iov_len;
+    }
+    
+    if (buflen <= 0) {
+        return 0;
+    }
+    
+    // readers already waiting are owed the buffered characters first
+    if (g_kbd_readers_head == NULL && keyboard_read_ready(buflen)) {
+        return keyboard_buffer_take(iov, iovcnt);
+    }
+    
+    kbd_reader_t *reader =
+        kslab_alloc(sizeof(kbd_reader_t) + iovcnt * sizeof(iovec_t));
+    if (reader == NULL) {
+        return SYSERR;
+    }
+    
+    reader->proc = proc;
+    reader->buflen = buflen;
+    reader->iovcnt = iovcnt;
+    reader->next = NULL;
+    blkcopy(reader->iov, (void*)iov, iovcnt * sizeof(iovec_t));
+    
+    if (g_kbd_readers_tail == NULL) {
+        g_kbd_readers_head = reader;
+    } else {
+        g_kbd_readers_tail->next = reader;
+    }
+    g_kbd_readers_tail = reader;
+    
+    return BLOCKERR;
+}
+
 /******************************************************************************
  * Keyboard lower-half functions
  ******************************************************************************/
@@ -251,8 +424,8 @@ static int kbd_ioctl_set_eof(void *args) {
  * Function called when a keyboard interrupt occurs.
  * Reads the data from the keyboard's registers via ports and handles the data
  *
- * The data will either be directly written to a waiting proc's buffer
- * or be buffered internally in g_keyboard_buffer to wait for future reads.
+ * The character is added to the buffer, or counted as dropped if it is
+ * full, and the oldest waiting reader is woken if its read can complete.
  */
 void keyboard_isr(void) {
     int isDataPresent;
@@ -262,109 +435,141 @@ void keyboard_isr(void) {
     isDataPresent = KEYBOARD_PORT_CONTROL_READY_MASK & inb(KEYBOARD_PORT_CONTROL);
     data = KEYBOARD_PORT_DATA_SCANCODE_MASK & inb(KEYBOARD_PORT_DATA);
     
-    if (isDataPresent) {
-        c = keyboard_process_scancode(data);
-        
-        if (c != 0) {
-            if (g_keyboard_echo_flag && c != g_keyboard_eof) {
-                kprintf("%c", c);
-            }
-            
-            if (g_kbd_task_refcount > 0) {
-                // If there is a task waiting, write to task
-                keyboard_process_char(c);
-            } else if (((g_keyboard_buffer_head + 1) % KEYBOARD_BUFFER_SIZE) != g_keyboard_buffer_tail) {
-                // Make sure buffer has room
-                g_keyboard_buffer[g_keyboard_buffer_head] = c;
-                g_keyboard_buffer_head = (g_keyboard_buffer_head + 1) % KEYBOARD_BUFFER_SIZE;
-            }
-        }
+    if (!isDataPresent) {
+        return;
     }
-}
-
-/**
- * keyboard_flush_buffer
- * Flush the entire keyboard buffer into the buffers held by blocked processes
- */
-static void keyboard_flush_buffer(void) {
-    char c;
     
-    // While the buffer still has some contents in it
-    while (g_kbd_task_refcount > 0 &&
-        g_keyboard_buffer_tail != g_keyboard_buffer_head) {
-            
-        c = g_keyboard_buffer[g_keyboard_buffer_tail];
-        keyboard_process_char(c);
-        g_keyboard_buffer_tail = (g_keyboard_buffer_tail + 1) % KEYBOARD_BUFFER_SIZE;
+    c = keyboard_process_scancode(data);
+    if (c == 0) {
+        return;
     }
-}
-
-/**
- * keyboard_process_char
- * Logic for handling a ascii character, namely handling EOFs and newlines
- * @param c - ascii character
- */
-static void keyboard_process_char(char c) {
-    int i;
-    kbd_task_t *task;
     
     if (c == g_keyboard_eof) {
         keyboard_handle_eof();
         return;
     }
     
-    for (i = 0; i < KBD_TASK_LIST_SIZE; i++) {
-        if (g_kbd_task_list[i].waiting_on_read) {
-            task = &g_kbd_task_list[i];
-            ((char*)(task->buf))[task->i] = c;
-            task->i++;
-            
-            // Unblock once we've filled the buffer, OR  we encounter \n
-            if (task->i == task->buflen || c == '\n') {
-                keyboard_unblock_proc(task);
-            }
-        }
+    if (g_keyboard_echo_flag) {
+        kprintf("%c", c);
+    }
+    
+    unsigned int head = g_keyboard_buffer_head;
+    if (head - g_keyboard_buffer_tail == g_keyboard_buffer_size) {
+        g_keyboard_dropped++;
+        return;
+    }
+    
+    g_keyboard_buffer[head & (g_keyboard_buffer_size - 1)] = c;
+    if (c == '\n') {
+        g_keyboard_newlines_in++;
     }
+    // the character must be in place before readers can see it
+    __asm__ __volatile__("" ::: "memory");
+    g_keyboard_buffer_head = head + 1;
+    
+    keyboard_serve_readers();
 }
 
 /**
  * keyboard_handle_eof
  * Logic for handling EOF character, namely waking all blocked processes.
+ * Each still gets what is left in the buffer, in turn.
  */
 static void keyboard_handle_eof(void) {
-    int i;
-    kbd_task_t *task;
-    
     setEnabledKbd(0);
     g_kbd_done = 1;
-    
-    // Flush all queues
-    for (i = 0; i < KBD_TASK_LIST_SIZE; i++) {
-        if (g_kbd_task_list[i].waiting_on_read) {
-            task = &g_kbd_task_list[i];
-            keyboard_unblock_proc(task);
+    keyboard_serve_readers();
+}
+
+/**
+ * keyboard_serve_readers
+ * Completes the reads at the head of the wait queue that can be completed
+ * with the characters buffered, and unblocks their processes
+ */
+static void keyboard_serve_readers(void) {
+    while (g_kbd_readers_head != NULL &&
+           keyboard_read_ready(g_kbd_readers_head->buflen)) {
+        kbd_reader_t *reader = g_kbd_readers_head;
+        g_kbd_readers_head = reader->next;
+        if (g_kbd_readers_head == NULL) {
+            g_kbd_readers_tail = NULL;
         }
+        
+        proc_ctrl_block_t *proc = reader->proc;
+        ASSERT_EQUAL(proc->curr_state, PROC_STATE_BLOCKED);
+        ASSERT_EQUAL(proc->blocking_queue_name, DEVICE);
+        
+        proc->ret = keyboard_buffer_take(reader->iov, reader->iovcnt);
+        proc->blocking_queue_name = NO_BLOCKER;
+        add_pcb_to_queue(proc, PROC_STATE_READY);
+        
+        kslab_free(reader);
     }
+}
+
+/**
+ * keyboard_read_ready
+ * @param buflen - length of the read
+ * @return 1 if a read of buflen characters can complete now, 0 otherwise
+ */
+static int keyboard_read_ready(int buflen) {
+    unsigned int count = g_keyboard_buffer_head - g_keyboard_buffer_tail;
     
-    return;
+    return g_kbd_done ||
+        g_keyboard_newlines_in != g_keyboard_newlines_out ||
+        count >= MIN((unsigned int)buflen, g_keyboard_buffer_size);
 }
 
 /**
- * keyboard_unblock_proc
- * Helper method to unblock a process
- * @param pcb - proc to unblock
- * @param retval - return value to set in the pcb
+ * keyboard_buffer_take
+ * Moves characters from the buffer into a reader's buffers, filling each
+ * in turn, and stopping after a newline
+ * @param iov - buffers to read into
+ * @param iovcnt - number of buffers in iov
+ * @return number of characters read
  */
-static void keyboard_unblock_proc(kbd_task_t *task) {
-    ASSERT(task != NULL);
-    g_kbd_task_refcount--;
-    task->waiting_on_read = 0;
-    task->pcb->ret = task->i;
-    // Edge case: Make sure we only unblock BLOCKED processes
-    if (task->pcb->curr_state == PROC_STATE_BLOCKED) {
-        add_pcb_to_queue(task->pcb, PROC_STATE_READY);
-        task->pcb->blocking_queue_name = NO_BLOCKER;
+static int keyboard_buffer_take(const iovec_t *iov, int iovcnt) {
+    unsigned int tail = g_keyboard_buffer_tail;
+    unsigned int head = g_keyboard_buffer_head;
+    unsigned int mask = g_keyboard_buffer_size - 1;
+    int total = 0;
+    int newline = 0;
+    
+    for (int i = 0; i < iovcnt && tail != head && !newline; i++) {
+        char *buf = iov[i].iov_base;
+        int j = 0;
+        
+        while (j < iov[i].iov_len && tail != head) {
+            char c = g_keyboard_buffer[tail & mask];
+            tail++;
+            buf[j++] = c;
+            
+            if (c == '\n') {
+                g_keyboard_newlines_out++;
+                newline = 1;
+                break;
+            }
+        }
+        
+        total += j;
     }
+    
+    // the characters must be copied out before the isr can overwrite them
+    __asm__ __volatile__("" ::: "memory");
+    g_keyboard_buffer_tail = tail;
+    return total;
+}
+
+/**
+ * keyboard_buffer_reset
+ * Empties the buffer, and its count of dropped characters
+ */
+static void keyboard_buffer_reset(void) {
+    g_keyboard_buffer_head = 0;
+    g_keyboard_buffer_tail = 0;
+    g_keyboard_newlines_in = 0;
+    g_keyboard_newlines_out = 0;
+    g_keyboard_dropped = 0;
 }
 
 /**
@@ -1,4 +1,4 @@
-/* kprintf.c - kprintf, kputc, kbmputc */
+/* kprintf.c - kprintf, kconsole_write, kconsole_cursor */
 
 #include <i386.h>
 #include <xeroslib.h>
@@ -7,22 +7,31 @@
 
 static  int kputc(int, unsigned char);
 
+/* kprintf collects its output here, and writes it to the screen in bulk */
+#define	KPRINTF_BUF_SIZE	128
+typedef struct kprintf_buf {
+	int		len;
+	char		data[KPRINTF_BUF_SIZE];
+} kprintf_buf_t;
+
 
 /*------------------------------------------------------------------------
- *  kprintf  --  kernel printf: formatted, unbuffered output to CONSOLE
+ *  kprintf  --  kernel printf: formatted output to CONSOLE, written to the
+ *              screen in bulk once formatted
  *------------------------------------------------------------------------
  */
 int kprintf(char * fmt, ...)
 {
-  //	unsigned int	saveof;
-
+  kprintf_buf_t out;
   va_list ap;
-  va_start(ap, fmt);
-  
-    //  _doprnt(fmt, &args, kputc, 0);
 
-    _doprnt(fmt, (void *) ap,  kputc, 0);
+  out.len = 0;
+  va_start(ap, fmt);
+  _doprnt(fmt, (void *) ap,  kputc, (unsigned int) &out);
   va_end(ap);
+
+  kconsole_write(out.data, out.len);
+  kconsole_cursor();
   return 1;
 }
 
@@ -78,6 +87,9 @@ int kprintf(char * fmt, ...)
 
 static unsigned char	att = 0x7;
 unsigned char *Crtat = (unsigned char *)CGA_BUF;
+static unsigned char	*crtat = 0;
+/* where the 6845 was last told the cursor is, -1 if not yet */
+static int		cursor_pos = -1;
 
 static unsigned int addr_6845 = CGA_BASE;
 static void cursor(int pos)
@@ -89,95 +101,170 @@ static void cursor(int pos)
 }
 
 /*------------------------------------------------------------------------
- *  kbmputc - write one character to the physical monitor
+ *  kbminit - find the physical monitor and the cursor, clear the screen
  *------------------------------------------------------------------------
  */
-static void kbmputc( unsigned char c )
+static void kbminit(void)
 {
 	unsigned		cursorat;
 	unsigned short		was;
 	unsigned char		*cp;
-	static unsigned char	*crtat = 0;
-
-	if (c == 0)
-		return;
 
-	if (crtat == 0) {
-
-		/* XXX probe to find if a color or monochrome display */
-		was = *(unsigned short *)Crtat;
-		*(unsigned short *)Crtat = 0xA55A;
-		if (*(unsigned short *)Crtat != 0xA55A) {
-			Crtat = (unsigned char *) MONO_BUF;
-			addr_6845 = MONO_BASE;
-		}
-		*(unsigned short *)Crtat = was;
+	/* XXX probe to find if a color or monochrome display */
+	was = *(unsigned short *)Crtat;
+	*(unsigned short *)Crtat = 0xA55A;
+	if (*(unsigned short *)Crtat != 0xA55A) {
+		Crtat = (unsigned char *) MONO_BUF;
+		addr_6845 = MONO_BASE;
+	}
+	*(unsigned short *)Crtat = was;
 
-		/* Extract cursor location */
-		outb(addr_6845,14);
-		cursorat = inb(addr_6845+1)<<8 ;
-		outb(addr_6845,15);
-		cursorat |= inb(addr_6845+1);
+	/* Extract cursor location */
+	outb(addr_6845,14);
+	cursorat = inb(addr_6845+1)<<8 ;
+	outb(addr_6845,15);
+	cursorat |= inb(addr_6845+1);
 
-		if (cursorat <= COL * ROW)
-			crtat = Crtat + cursorat * CHR;
-		else
-			crtat = Crtat;
+	if (cursorat <= COL * ROW)
+		crtat = Crtat + cursorat * CHR;
+	else
+		crtat = Crtat;
+	cursor_pos = cursorat;
 
-		/* clean display */
-		for (cp = crtat; cp < Crtat+ROW*COL*CHR; cp += 2) {
-			cp[0] = ' ';
-			cp[1] = att;
-		}
+	/* clean display */
+	for (cp = crtat; cp < Crtat+ROW*COL*CHR; cp += 2) {
+		cp[0] = ' ';
+		cp[1] = att;
 	}
+}
 
+/*------------------------------------------------------------------------
+ *  kbmadvance - where a character leaves the cursor, counted in cells
+ *  from the top of the screen, and possibly past its bottom
+ *------------------------------------------------------------------------
+ */
+static int kbmadvance(int pos, unsigned char c)
+{
 	switch (c) {
 
+	case 0:
+		return pos;
+
 	case '\t':
-		do
-			kbmputc(' ');
-		while ((int)crtat % (8*CHR));
-		break;
+		return (pos + 8) & ~7;
 
 	case '\010':
-		crtat -= CHR;
-		break;
+		return pos > 0 ? pos - 1 : 0;
 
 	case '\n':
-		crtat += COL*CHR ;
-		/* fall through */
+		return pos + COL - pos % COL;
+
 	case '\r':
-		crtat -= (crtat - Crtat) % (COL*CHR);
-		break;
+		return pos - pos % COL;
 
 	default:
-		crtat[0] = c;
-		crtat[1] = att;
-		crtat += CHR;
-		break ;
+		return pos + 1;
+	}
+}
+
+/*------------------------------------------------------------------------
+ *  kconsole_write - write characters to the physical monitor
+ *
+ *  The text is laid out twice. The first pass only finds how far below
+ *  the screen it runs, so the screen can be scrolled that many lines with
+ *  one blkcopy. The second writes the glyphs that are still on the screen
+ *  afterwards straight into video memory. The cursor is left for
+ *  kconsole_cursor, so callers writing several buffers move it only once.
+ *------------------------------------------------------------------------
+ */
+void kconsole_write(const char *buf, int len)
+{
+	int		start, pos, maxpos, scroll, i;
+	unsigned char	*cp;
+
+	if (crtat == 0)
+		kbminit();
+
+	start = (crtat - Crtat) / CHR;
+	pos = start;
+	maxpos = start;
+	for (i = 0; i < len; i++) {
+		pos = kbmadvance(pos, buf[i]);
+		if (pos > maxpos)
+			maxpos = pos;
 	}
 
-	/* implement a scroll */
-	if (crtat >= Crtat+COL*ROW*CHR) {
+	/* the screen scrolls a line each time the cursor runs off its end */
+	scroll = maxpos / COL - (ROW - 1);
+	if (scroll < 0)
+		scroll = 0;
+
+	if (scroll > 0) {
 		/* move text up */
-		blkcopy(Crtat, Crtat+COL*CHR, COL*(ROW-1)*CHR);
+		if (scroll < ROW)
+			blkcopy(Crtat, Crtat + scroll*COL*CHR,
+				(ROW - scroll)*COL*CHR);
 
-		/* clear line */
-		for (cp = Crtat+ COL*(ROW-1)*CHR;
-			cp < Crtat + COL*ROW*CHR ; cp += 2)
+		/* clear lines */
+		for (cp = Crtat + (ROW - MIN(scroll, ROW))*COL*CHR;
+			cp < Crtat + COL*ROW*CHR; cp += 2)
 			cp[0] = ' ';
+	}
+
+	pos = start;
+	for (i = 0; i < len; i++) {
+		unsigned char c = buf[i];
+		int next = kbmadvance(pos, c);
+
+		/* glyphs, and the blanks a tab skips over */
+		if (c == '\t' || (c != 0 && c != '\010' && c != '\n' && c != '\r')) {
+			for (; pos < next; pos++) {
+				if (pos < scroll*COL)
+					continue;
+				cp = Crtat + (pos - scroll*COL)*CHR;
+				cp[0] = (c == '\t') ? ' ' : c;
+				cp[1] = att;
+			}
+		}
 
-		crtat -= COL*CHR ;
+		pos = next;
 	}
 
-	cursor((crtat-Crtat)/CHR);
+	pos -= scroll*COL;
+	crtat = Crtat + MAX(pos, 0)*CHR;
 }
 
 /*------------------------------------------------------------------------
- * kputc - do a synchronous kernel write to the console tty
+ *  kconsole_cursor - move the 6845's cursor to where writing left off,
+ *  if it has moved
+ *------------------------------------------------------------------------
+ */
+void kconsole_cursor(void)
+{
+	int	pos;
+
+	if (crtat == 0)
+		kbminit();
+
+	pos = (crtat - Crtat) / CHR;
+	if (pos != cursor_pos) {
+		cursor(pos);
+		cursor_pos = pos;
+	}
+}
+
+/*------------------------------------------------------------------------
+ * kputc - collect a character for kprintf to write
  *------------------------------------------------------------------------
  */
 static int kputc(int dev, unsigned char c) {
-  kbmputc(c);
+  kprintf_buf_t *out = (kprintf_buf_t *) dev;
+
+  if (out->len == KPRINTF_BUF_SIZE) {
+    kconsole_write(out->data, out->len);
+    out->len = 0;
+  }
+
+  out->data[out->len++] = c;
   return (int) c;
 }
@@ -11,32 +11,109 @@ Called from outside:
 
   kmem_dump_free_list() - prints free list, testing purposes only
   kmem_get_free_list_length() - returns length of free list, testing only
+  kmem_get_num_regions() - returns number of regions in the heap
+  kmem_get_free_stats() - returns total and largest free memory, testing only
+
+Note:
+  Every block carries its size in a header and in a footer (boundary tag),
+  with the low bit of the size marking the block as in use. Given any block,
+  its physical neighbours can then be found and checked in constant time,
+  so kfree coalesces without searching the free list, and the free list
+  itself need not be kept in address order.
+
+  How free blocks are organized is selected at build time (see KMEM_POLICY
+  in compile/Makefile):
+    FIRST_FIT - a single free list, searched from the front (the default)
+    TLSF      - Two-Level Segregated Fit. Free blocks are kept in lists
+                segregated by size class, with a bitmap of non-empty lists,
+                so kmalloc finds a suitable block in O(1) time.
 
 Further details can be found in the documentation above the function headers.
 */
 
 #include <xeroskernel.h>
 #include <i386.h>
+#include <bitops.h>
 
 extern long	freemem; 	/* start of free memory (set in i386.c) */
 extern char	*maxaddr;	/* max memory address (set in i386.c)	*/
 
+/* number of separate regions making up the heap */
+static int g_num_regions;
+
 typedef struct memory_header {
-    /* The size of the memory region + this memory_header */
+    /* The size of the memory region + this memory_header + its footer.
+     * The lowest bit is BLOCK_IN_USE, set while the block is allocated */
     size_t size;
     
+    /* Free list links, only valid while the block is free */
     struct memory_header *prev;
     struct memory_header *next;
     
-    /* sanity_check and data_start should be equal */
+    /* sanity_check and data_start should be equal while allocated */
     struct memory_header *sanity_check;
     unsigned char data_start[];
 } memory_header_t;
 
+/* Boundary tag at the end of every block, a copy of the header's size field.
+ * It lets kfree find the physically previous block in constant time. */
+typedef struct memory_footer {
+    size_t size;
+} memory_footer_t;
+
+/* sizes are always multiples of 16, so the low bits are free for flags */
+#define BLOCK_IN_USE 0x1
+#define BLOCK_SIZE(tag) ((tag)->size & ~BLOCK_IN_USE)
+#define BLOCK_IS_USED(tag) ((tag)->size & BLOCK_IN_USE)
+
+/* smallest block worth splitting off: a header, a footer, and some data */
+#define MIN_BLOCK_SIZE (sizeof(memory_header_t) + 0x10)
+
+#if defined(KMEM_POLICY_TLSF)
+
+/* Blocks smaller than TLSF_SMALL_BLOCK_SIZE share a single first level list,
+ * split linearly into 16 byte second level classes. Larger blocks use one
+ * first level list per power of two, split into TLSF_SL_COUNT classes each */
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_ALIGN_LOG2 4
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK_SIZE (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_MAX 31
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+#define NUM_FREE_LISTS (TLSF_FL_COUNT * TLSF_SL_COUNT)
+
+/* bit fl of g_fl_bitmap is set if any list in g_sl_bitmap[fl] is non-empty */
+static unsigned int g_fl_bitmap;
+static unsigned int g_sl_bitmap[TLSF_FL_COUNT];
+static memory_header_t *g_free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+static void mapping_insert(size_t size, int *fl, int *sl);
+static void mapping_search(size_t size, int *fl, int *sl);
+
+#else
+
+#define NUM_FREE_LISTS 1
+
 static memory_header_t *g_free_list;
 
-static void split_free_block(memory_header_t *block, size_t size);
-static int coalesce_blocks(memory_header_t *block1, memory_header_t *block2);
+#endif
+
+static void add_usable_region(size_t start, size_t end);
+static void add_region(size_t start, size_t end);
+static memory_header_t* split_free_block(memory_header_t *block, size_t size);
+static void coalesce_blocks(memory_header_t *block1, memory_header_t *block2);
+static void set_block_size(memory_header_t *block, size_t size);
+static memory_footer_t* block_footer(memory_header_t *block);
+static memory_header_t* next_block(memory_header_t *block);
+static memory_header_t* prev_block(memory_header_t *block);
+static void free_lists_init(void);
+static memory_header_t* free_list_head(int list);
+static void insert_free_block(memory_header_t *block);
+static void remove_free_block(memory_header_t *block);
+static memory_header_t* find_free_block(size_t size);
+static void take_free_block(memory_header_t *block, size_t size);
 static void kmem_dump_block(memory_header_t *ptr);
 static size_t round_to_paragraph(size_t val);
 
@@ -52,24 +129,79 @@ void kmeminit(void) {
     DEBUG("Hole start: 0x%x\n", HOLESTART);
     DEBUG("Hole end:   0x%x\n", HOLEEND);
     DEBUG("Max addr:   0x%x\n", maxaddr);
+    DEBUG("Regions:    %d\n", nmemregions);
   
-    /* Create the free list, consisting of two regions surrounding the HOLE */
-    memory_header_t *post_hole_region = (memory_header_t*) HOLEEND;
-    post_hole_region->size = (size_t)(maxaddr - HOLEEND);
-    post_hole_region->sanity_check = NULL;
-  
-    size_t memstart = round_to_paragraph(freemem);
+    /* Create the free list from every usable region found by sizmem, less
+     * the kernel and the HOLE. Free blocks are pushed on the front of their
+     * list, so add the regions from high to low memory to have first fit
+     * prefer low memory */
+    free_lists_init();
+    g_num_regions = 0;
+    for (int i = nmemregions - 1; i >= 0; i--) {
+        size_t start = MAX(memregions[i].mr_start, (size_t)freemem);
+        size_t end = memregions[i].mr_end;
+
+        // regions are sorted, but the BIOS may report overlapping ones
+        if (i > 0) {
+            start = MAX(start, memregions[i - 1].mr_end);
+        }
 
-    g_free_list = (memory_header_t *)memstart;
-    g_free_list->size = (size_t)(HOLESTART - memstart);
-    g_free_list->sanity_check = NULL;
-  
-    g_free_list->prev = NULL;
-    g_free_list->next = post_hole_region;
-    post_hole_region->prev = g_free_list;
-    post_hole_region->next = NULL;
+        if (start < HOLEEND && end > HOLESTART) {
+            add_usable_region(HOLEEND, end);
+            end = HOLESTART;
+        }
+        add_usable_region(start, end);
+    }
+
+    ASSERT(g_num_regions > 0);
+    ASSERT_EQUAL(kmem_get_free_list_length(), g_num_regions);
+}
+
+/**
+ * Adds a region to the heap, if it is large enough to hold a block
+ * @param start - first address of the region
+ * @param end - first address past the end of the region
+ */
+static void add_usable_region(size_t start, size_t end) {
+    if (end <= start ||
+        end - start < 2 * sizeof(memory_header_t) + MIN_BLOCK_SIZE + 0x10) {
+        return;
+    }
+
+    DEBUG("Adding region 0x%x to 0x%x\n", start, end);
+    add_region(start, end);
+    g_num_regions++;
+}
 
-    ASSERT_EQUAL(kmem_get_free_list_length(), 2);
+/**
+ * Adds a region of memory to the heap as a single free block.
+ * The region is bracketed by fenceposts which are permanently in use,
+ * so coalescing never looks outside of the region.
+ * @param start - first address of the region
+ * @param end - first address past the end of the region
+ */
+static void add_region(size_t start, size_t end) {
+    start = round_to_paragraph(start);
+    end &= ~0xf;
+    ASSERT(end - start >= 2 * sizeof(memory_header_t) + MIN_BLOCK_SIZE);
+
+    // prologue: reserve a paragraph whose last word looks like a used footer
+    memory_footer_t *prologue =
+        (memory_footer_t*)(start + sizeof(memory_header_t)) - 1;
+    prologue->size = sizeof(memory_header_t) | BLOCK_IN_USE;
+
+    // epilogue: a used header with no data, in the region's last paragraph
+    memory_header_t *epilogue =
+        (memory_header_t*)(end - sizeof(memory_header_t));
+    epilogue->size = sizeof(memory_header_t) | BLOCK_IN_USE;
+    epilogue->sanity_check = NULL;
+
+    memory_header_t *block =
+        (memory_header_t*)(start + sizeof(memory_header_t));
+    set_block_size(block, (size_t)epilogue - (size_t)block);
+    block->sanity_check = NULL;
+
+    insert_free_block(block);
 }
 
 /**
@@ -80,6 +212,15 @@ long kmem_maxaddr(void) {
     return (long)maxaddr;
 }
 
+/**
+ * Returns the number of separate regions making up the heap, which is the
+ * length of the free list when nothing is allocated
+ * @return number of regions
+ */
+int kmem_get_num_regions(void) {
+    return g_num_regions;
+}
+
 /**
  * Returns the start of free memory
  * @return freemem
@@ -111,41 +252,30 @@ void* kmalloc(size_t size) {
         return NULL;
     }
 
-    size_t size_required = round_to_paragraph(size) + sizeof(memory_header_t);
-
-    /* Using first fit. Donald said in class best fit wasn't necessary */
-    memory_header_t *curr = g_free_list;
-    while (curr != NULL) {
-        if (size_required <= curr->size) {
-            split_free_block(curr, size_required);
-
-            if (curr->prev) {
-                curr->prev->next = curr->next;
-            } else {
-                g_free_list = curr->next;
-            }
-
-            if (curr->next) {
-                curr->next->prev = curr->prev;
-            }
-
-            curr->size = size_required;
-            curr->sanity_check = (memory_header_t *)curr->data_start;
-
-            // only allocate on 16 byte boundaries, last 4 bits must always be 0
-            ASSERT_EQUAL(((size_t)curr->data_start & 0xf), 0);
-            return curr->data_start;
-        }
+    size_t size_required = round_to_paragraph(size + sizeof(memory_footer_t)) +
+                           sizeof(memory_header_t);
 
-        curr = curr->next;
+    memory_header_t *curr = find_free_block(size_required);
+    if (curr == NULL) {
+        DEBUG("kmalloc could not allocate sufficient memory\n");
+        return NULL;
     }
 
-    DEBUG("kmalloc could not allocate sufficient memory\n");
-    return NULL;
+    take_free_block(curr, size_required);
+
+    curr->size |= BLOCK_IN_USE;
+    block_footer(curr)->size = curr->size;
+    curr->sanity_check = (memory_header_t *)curr->data_start;
+
+    // only allocate on 16 byte boundaries, last 4 bits must always be 0
+    ASSERT_EQUAL(((size_t)curr->data_start & 0xf), 0);
+    return curr->data_start;
 }
 
 /**
  * Frees block of memory previous allocated with kmalloc, for future use.
+ * Neighbouring free blocks are found through their boundary tags,
+ * so freeing takes constant time regardless of the free list's length.
  * @param ptr - start of block returned by kmalloc, to be freed
  */
 void kfree(void *ptr) {
@@ -160,101 +290,378 @@ void kfree(void *ptr) {
 
     memory_header_t *to_free = (memory_header_t*)(ptr - sizeof(memory_header_t));
     ASSERT_EQUAL(to_free->sanity_check, ptr);
+    ASSERT(BLOCK_IS_USED(to_free));
+    ASSERT_EQUAL(block_footer(to_free)->size, to_free->size);
+
+    // catch double frees
+    to_free->sanity_check = NULL;
+
+    set_block_size(to_free, BLOCK_SIZE(to_free));
     
-    /* Search the free list for a place to put our new memory segment */
-    memory_header_t *prev = NULL;
-    memory_header_t *curr = g_free_list;
-    while (curr != NULL && curr < to_free) {
-        prev = curr;
-        curr = curr->next;
-    }
-    
-    /* Insert into free list */
-    if (prev == NULL) {
-        g_free_list = to_free;
-    } else {
-        prev->next = to_free;
+    // Coalesce if needed. Neighbours leave the free lists before being merged,
+    // as a block's size may determine which list it is in
+    memory_header_t *next = next_block(to_free);
+    if (!BLOCK_IS_USED(next)) {
+        remove_free_block(next);
+        coalesce_blocks(to_free, next);
     }
-    
-    to_free->prev = prev;
-    to_free->next = curr;
-    
-    if (curr != NULL) {
-        curr->prev = to_free;
+
+    memory_footer_t *prev_footer = (memory_footer_t*)to_free - 1;
+    if (!BLOCK_IS_USED(prev_footer)) {
+        memory_header_t *prev = prev_block(to_free);
+        remove_free_block(prev);
+        coalesce_blocks(prev, to_free);
+        to_free = prev;
     }
-    
-    // Coalesce if needed. Notice the order here matters to simplify the logic
-    coalesce_blocks(to_free, to_free->next);
-    coalesce_blocks(to_free->prev, to_free);
+
+    insert_free_block(to_free);
 }
 
 /**
  * Splits a free block into two free blocks,
  * with the first block having the size provided.
+ * Only the boundary tags are changed, neither block's list links are touched.
  * @param block - the block to split_free_block
  * @param size - the new size for block
+ * @return the second block, or NULL if block was not split
  */
-static void split_free_block(memory_header_t *block, size_t size) {
+static memory_header_t* split_free_block(memory_header_t *block, size_t size) {
     ASSERT(block != NULL);
-    ASSERT(block->size >= size);
+    ASSERT(BLOCK_SIZE(block) >= size);
 
-    // perfect fit, no split necessary
-    if (block->size == size) {
-        return;
+    // (nearly) perfect fit, the remainder would be too small to use
+    if (BLOCK_SIZE(block) - size < MIN_BLOCK_SIZE) {
+        return NULL;
     }
 
     memory_header_t *other_half = (memory_header_t*)((size_t)block + size);
-    other_half->size = block->size - size;
-    other_half->prev = block;
-    other_half->next = block->next;
+    set_block_size(other_half, BLOCK_SIZE(block) - size);
     other_half->sanity_check = NULL;
-    if (other_half->next != NULL) {
-        other_half->next->prev = other_half;
-    }
 
-    block->next = other_half;
-    block->size = size;
+    set_block_size(block, size);
+    return other_half;
 }
 
 /**
- * If block1 and block2 are adjacent blocks, they are combined into block1.
- * Otherwise they are both unchanged.
+ * Combines two physically adjacent free blocks into block1.
+ * Neither block may be in a free list.
  *
- * block1 is assumed to be a lower address value than block2
- * @param[in] block1 - lower address block to try and coalesce
- * @param[in] block2 - higher address block to try and coalesce
- * @return - 1 if blocks were coalesced, 0 otherwise
- */
-static int coalesce_blocks(memory_header_t *block1, memory_header_t *block2) {
-    if (block1 == NULL || block2 == NULL) {
-        return 0;
+ * block1 is assumed to be directly below block2 in memory
+ * @param[in] block1 - lower address block to coalesce
+ * @param[in] block2 - higher address block to coalesce
+ */
+static void coalesce_blocks(memory_header_t *block1, memory_header_t *block2) {
+    ASSERT(block1 != NULL && block2 != NULL);
+    ASSERT(!BLOCK_IS_USED(block1) && !BLOCK_IS_USED(block2));
+    ASSERT_EQUAL(next_block(block1), block2);
+
+    set_block_size(block1, BLOCK_SIZE(block1) + BLOCK_SIZE(block2));
+}
+
+/**
+ * Sets a block's size in both its header and footer. Clears BLOCK_IN_USE.
+ * @param block - the block to resize
+ * @param size - new size of the block, including its header and footer
+ */
+static void set_block_size(memory_header_t *block, size_t size) {
+    ASSERT_EQUAL((size & 0xf), 0);
+    block->size = size;
+    block_footer(block)->size = size;
+}
+
+/**
+ * Returns the boundary tag at the end of a block
+ * @param block - the block whose footer we want
+ * @return block's footer
+ */
+static memory_footer_t* block_footer(memory_header_t *block) {
+    return (memory_footer_t*)((size_t)block + BLOCK_SIZE(block)) - 1;
+}
+
+/**
+ * Returns the block physically following this one
+ * @param block - any block
+ * @return the next block in memory
+ */
+static memory_header_t* next_block(memory_header_t *block) {
+    return (memory_header_t*)((size_t)block + BLOCK_SIZE(block));
+}
+
+/**
+ * Returns the block physically preceding this one, found via its footer.
+ * Only meaningful if that block is not a prologue fencepost.
+ * @param block - any block
+ * @return the previous block in memory
+ */
+static memory_header_t* prev_block(memory_header_t *block) {
+    memory_footer_t *prev_footer = (memory_footer_t*)block - 1;
+    return (memory_header_t*)((size_t)block - BLOCK_SIZE(prev_footer));
+}
+
+#if defined(KMEM_POLICY_TLSF)
+
+/*****************************************************************************
+ * Two-Level Segregated Fit free lists
+ *****************************************************************************/
+
+/**
+ * Empties all free lists
+ */
+static void free_lists_init(void) {
+    g_fl_bitmap = 0;
+    for (int fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        g_sl_bitmap[fl] = 0;
+        for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            g_free_lists[fl][sl] = NULL;
+        }
     }
-    
-    /* If there is no space between the blocks, combine them */
-    if ((size_t)block1 + block1->size == (size_t)block2) {
-        block1->next = block2->next;
-        if (block1->next != NULL) {
-            block1->next->prev = block1;
+}
+
+/**
+ * Returns the head of one of the free lists, for iterating over all of them
+ * @param list - index of the list, less than NUM_FREE_LISTS
+ * @return first block in the list
+ */
+static memory_header_t* free_list_head(int list) {
+    return g_free_lists[list / TLSF_SL_COUNT][list % TLSF_SL_COUNT];
+}
+
+/**
+ * Pushes a block onto the front of the list for its size class
+ * @param block - the free block to insert
+ */
+static void insert_free_block(memory_header_t *block) {
+    int fl, sl;
+    mapping_insert(BLOCK_SIZE(block), &fl, &sl);
+
+    block->prev = NULL;
+    block->next = g_free_lists[fl][sl];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    g_free_lists[fl][sl] = block;
+
+    FLAG_BIT_SET(g_fl_bitmap, fl);
+    FLAG_BIT_SET(g_sl_bitmap[fl], sl);
+}
+
+/**
+ * Unlinks a block from the list for its size class.
+ * Must be called before the block is resized.
+ * @param block - the free block to remove
+ */
+static void remove_free_block(memory_header_t *block) {
+    int fl, sl;
+    mapping_insert(BLOCK_SIZE(block), &fl, &sl);
+
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        ASSERT_EQUAL(g_free_lists[fl][sl], block);
+        g_free_lists[fl][sl] = block->next;
+    }
+
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+
+    if (g_free_lists[fl][sl] == NULL) {
+        FLAG_BIT_CLEAR(g_sl_bitmap[fl], sl);
+        if (g_sl_bitmap[fl] == 0) {
+            FLAG_BIT_CLEAR(g_fl_bitmap, fl);
         }
-        
-        block1->size += block2->size;
-        return 1;
     }
-    
-    return 0;
+
+    // done for safety
+    block->prev = NULL;
+    block->next = NULL;
+}
+
+/**
+ * Finds a free block of at least size bytes in constant time.
+ * The size is rounded up to the next size class, so any block in the
+ * first non-empty list at or above that class is large enough.
+ * @param size - minimum block size, including header and footer
+ * @return a large enough free block, or NULL if there is none
+ */
+static memory_header_t* find_free_block(size_t size) {
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+
+    // look for a non-empty list in this first level, at or above sl
+    unsigned int sl_map = g_sl_bitmap[fl] & (~0U << sl);
+    if (sl_map == 0) {
+        // none, so take the smallest non-empty list from a larger first level
+        unsigned int fl_map = (fl + 1 < TLSF_FL_COUNT) ?
+                              g_fl_bitmap & (~0U << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+
+        fl = bit_scan_forward(fl_map);
+        sl_map = g_sl_bitmap[fl];
+    }
+
+    sl = bit_scan_forward(sl_map);
+    ASSERT(g_free_lists[fl][sl] != NULL);
+    return g_free_lists[fl][sl];
+}
+
+/**
+ * Removes a free block from its list, trims it to size,
+ * and files the remainder under its own size class.
+ * @param block - the free block being allocated
+ * @param size - the size to trim the block to
+ */
+static void take_free_block(memory_header_t *block, size_t size) {
+    remove_free_block(block);
+
+    memory_header_t *other_half = split_free_block(block, size);
+    if (other_half != NULL) {
+        insert_free_block(other_half);
+    }
+}
+
+/**
+ * Finds the size class a free block of this size belongs to
+ * @param size - size of the block
+ * @param[out] fl - first level index
+ * @param[out] sl - second level index
+ */
+static void mapping_insert(size_t size, int *fl, int *sl) {
+    if (size < TLSF_SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = size >> TLSF_ALIGN_LOG2;
+    } else {
+        int msb = bit_scan_reverse(size);
+        *sl = (size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = msb - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+/**
+ * Finds the smallest size class whose blocks are all at least size bytes
+ * @param size - minimum block size
+ * @param[out] fl - first level index
+ * @param[out] sl - second level index
+ */
+static void mapping_search(size_t size, int *fl, int *sl) {
+    if (size >= TLSF_SMALL_BLOCK_SIZE) {
+        size += (1 << (bit_scan_reverse(size) - TLSF_SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+#else
+
+/*****************************************************************************
+ * First fit free list
+ *****************************************************************************/
+
+/**
+ * Empties the free list
+ */
+static void free_lists_init(void) {
+    g_free_list = NULL;
+}
+
+/**
+ * Returns the head of the free list
+ * @param list - must be 0, there is only one list
+ * @return first block in the list
+ */
+static memory_header_t* free_list_head(int list) {
+    ASSERT_EQUAL(list, 0);
+    return g_free_list;
 }
 
+/**
+ * Pushes a block onto the front of the free list
+ * @param block - the free block to insert
+ */
+static void insert_free_block(memory_header_t *block) {
+    block->prev = NULL;
+    block->next = g_free_list;
+    if (g_free_list != NULL) {
+        g_free_list->prev = block;
+    }
+    g_free_list = block;
+}
+
+/**
+ * Unlinks a block from the free list
+ * @param block - the free block to remove
+ */
+static void remove_free_block(memory_header_t *block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        g_free_list = block->next;
+    }
+
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+
+    // done for safety
+    block->prev = NULL;
+    block->next = NULL;
+}
+
+/**
+ * Finds the first free block of at least size bytes.
+ * Donald said in class best fit wasn't necessary.
+ * @param size - minimum block size, including header and footer
+ * @return a large enough free block, or NULL if there is none
+ */
+static memory_header_t* find_free_block(size_t size) {
+    memory_header_t *curr = g_free_list;
+    while (curr != NULL && BLOCK_SIZE(curr) < size) {
+        curr = curr->next;
+    }
+
+    return curr;
+}
+
+/**
+ * Removes a free block from the free list and trims it to size.
+ * The remainder takes the block's place in the list.
+ * @param block - the free block being allocated
+ * @param size - the size to trim the block to
+ */
+static void take_free_block(memory_header_t *block, size_t size) {
+    memory_header_t *other_half = split_free_block(block, size);
+    if (other_half != NULL) {
+        other_half->prev = block;
+        other_half->next = block->next;
+        if (other_half->next != NULL) {
+            other_half->next->prev = other_half;
+        }
+        block->next = other_half;
+    }
+
+    remove_free_block(block);
+}
+
+#endif
+
 /**
  * Dumps the entire free list into stdout
  */
 void kmem_dump_free_list(void) {
-    memory_header_t *ptr = g_free_list;
+    memory_header_t *ptr;
     int count = 0;
 
-    while (ptr != NULL) {
-        kmem_dump_block(ptr);
-        count++;
-        ptr = ptr->next;
+    for (int list = 0; list < NUM_FREE_LISTS; list++) {
+        ptr = free_list_head(list);
+        while (ptr != NULL) {
+            kmem_dump_block(ptr);
+            count++;
+            ptr = ptr->next;
+        }
     }
 
     DEBUG("%d blocks in free list\n", count);
@@ -262,6 +669,7 @@ void kmem_dump_free_list(void) {
 
 /**
  * Returns number of blocks in the free list.
+ * Also checks every free block's boundary tags along the way.
  * Purposely inefficient, should only be used for testing.
  * @return - number of blocks in our free list
  */
@@ -269,24 +677,56 @@ int kmem_get_free_list_length(void) {
     // While we could keep track of length through a static, global variable,
     // this simpler approach is taken to avoid being incorrect while debugging
 
-    memory_header_t *ptr = g_free_list;
+    memory_header_t *ptr;
     int count = 0;
 
-    while (ptr != NULL) {
-        count++;
-        ptr = ptr->next;
+    for (int list = 0; list < NUM_FREE_LISTS; list++) {
+        ptr = free_list_head(list);
+        while (ptr != NULL) {
+            // boundary tags must agree, free blocks must be fully coalesced
+            ASSERT(!BLOCK_IS_USED(ptr));
+            ASSERT_EQUAL(block_footer(ptr)->size, ptr->size);
+            ASSERT(BLOCK_IS_USED(next_block(ptr)));
+            ASSERT(BLOCK_IS_USED((memory_footer_t*)ptr - 1));
+
+            count++;
+            ptr = ptr->next;
+        }
     }
 
     return count;
 }
 
+/**
+ * Sums up the free memory, to measure fragmentation.
+ * Purposely inefficient, should only be used for testing.
+ * @param[out] total - total bytes in free blocks, including their headers
+ * @param[out] largest - size of the largest free block
+ */
+void kmem_get_free_stats(size_t *total, size_t *largest) {
+    memory_header_t *ptr;
+    *total = 0;
+    *largest = 0;
+
+    for (int list = 0; list < NUM_FREE_LISTS; list++) {
+        ptr = free_list_head(list);
+        while (ptr != NULL) {
+            *total += BLOCK_SIZE(ptr);
+            *largest = MAX(*largest, BLOCK_SIZE(ptr));
+            ptr = ptr->next;
+        }
+    }
+}
+
 /**
  * Helper method for dumping a memory_header_t node into stdout
  * @param ptr - memory_header to print
  */
 static void kmem_dump_block(memory_header_t *ptr) {
     DEBUG("================\n");
-    DEBUG("addr: 0x%x       | size: 0x%x\n", ptr, ptr->size);
+    DEBUG("addr: 0x%x       | size: 0x%x\n", ptr, BLOCK_SIZE(ptr));
+    DEBUG("in use: %d          | footer: 0x%x\n",
+          BLOCK_IS_USED(ptr), block_footer(ptr)->size);
     DEBUG("data_start: 0x%x | sanity: 0x%x\n",
           ptr->data_start, ptr->sanity_check);
     DEBUG("prev: 0x%x       | next: 0x%x\n", ptr->prev, ptr->next);
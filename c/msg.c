@@ -5,6 +5,23 @@ Called from outside:
   recv() - receives a message from a specific proc
   recv_any() - receives a message from any proc
 
+  post() - queues a message in a proc's mailbox, without blocking
+  mbox_recv() - takes the oldest message from a proc's own mailbox
+  mbox_free() - frees a proc's mailbox
+
+Note:
+  Every process shares the kernel's address space, so a message is copied
+  once, straight from the sender's buffer to the receiver's, and nothing is
+  buffered in the kernel. Messages are arbitrary binary data: the copy moves
+  a word at a time, and does not stop at NUL bytes. Both sides are told how
+  many bytes moved, the smaller of the two buffer lengths.
+
+  Mailboxes are the asynchronous alternative to send/recv. Each proc's
+  mailbox is a ring of MBOX_CAPACITY messages of up to MBOX_MSG_SIZE bytes,
+  allocated from the kernel heap the first time a message is posted to it.
+  Posting never blocks: the message is handed straight to the owner if it is
+  waiting in mbox_recv, or is queued, or the post fails if the ring is full.
+
 Further details can be found in the documentation above the function headers.
 */
 
@@ -12,13 +29,29 @@ Further details can be found in the documentation above the function headers.
 #include <xeroslib.h>
 #include <pcb.h>
 
+typedef struct mbox_msg {
+    int from_pid;
+    unsigned long len;
+    unsigned char data[MBOX_MSG_SIZE];
+} mbox_msg_t;
+
+typedef struct mailbox {
+    // oldest message is at head, next post goes to (head + count)
+    int head;
+    int count;
+    mbox_msg_t msgs[MBOX_CAPACITY];
+} mailbox_t;
+
+static unsigned long copy_message(void *dst, void *src, unsigned long dst_len,
+                                  unsigned long src_len);
+
 /**
  * Sends a message to another proc
  * @param srcproc - the process to send from
  * @param destproc - the process to receive the data
  * @param buffer - buffer containing the data
  * @param len - length of the data in buffer
- * @return SYSPID return codes
+ * @return bytes transferred, BLOCKERR if we must wait for the receiver
  */
 int send(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
          void *buffer, unsigned long len) {
@@ -35,16 +68,15 @@ int send(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
         }
 
         // Copy message into receiver's buffer
-        char *receiver_buf = (char*)destproc->args[1];
+        void *receiver_buf = (void*)destproc->args[1];
         unsigned long receiver_len = (unsigned long)destproc->args[2];
-        unsigned long tocopy_len = MIN(receiver_len, len);
-        strncpy(receiver_buf, buffer, tocopy_len);
+        int copied = copy_message(receiver_buf, buffer, receiver_len, len);
 
         // Unblock the receiver
         ASSERT_EQUAL(destproc->curr_state, PROC_STATE_BLOCKED);
-        destproc->ret = SYSPID_OK;
+        destproc->ret = copied;
         add_pcb_to_queue(destproc, PROC_STATE_READY);
-        return SYSPID_OK;
+        return copied;
     } else {
         // Case 2: We have to block until the receiver is ready
         add_proc_to_blocking_queue(srcproc, destproc, SENDER);
@@ -58,7 +90,7 @@ int send(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
  * @param destproc - the process to receive the data
  * @param buffer - buffer to store received data
  * @param len - length of buffer
- * @return SYSPID return codes
+ * @return bytes transferred, BLOCKERR if we must wait for the sender
  */
 int recv(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
          void *buffer, unsigned long len) {
@@ -69,14 +101,13 @@ int recv(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
         // Copy message into receiver's buffer
         void *sender_buf = (void*)srcproc->args[1];
         unsigned long sender_len = (unsigned long)srcproc->args[2];
-        unsigned long tocopy_len = MIN(sender_len, len);
-        strncpy(buffer, sender_buf, tocopy_len);
+        int copied = copy_message(buffer, sender_buf, len, sender_len);
         
         // Unblock the sender
         ASSERT_EQUAL(srcproc->curr_state, PROC_STATE_BLOCKED);
-        srcproc->ret = SYSPID_OK;
+        srcproc->ret = copied;
         add_pcb_to_queue(srcproc, PROC_STATE_READY);
-        return SYSPID_OK;
+        return copied;
     } else {
         // Case 2: Wait for sender
         add_proc_to_blocking_queue(destproc, srcproc, RECEIVER);
@@ -89,7 +120,8 @@ int recv(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
  * @param destproc - the process to receive the data
  * @param buffer - buffer to store received data
  * @param len - length of buffer
- * @return SYSPID return codes
+ * @return bytes transferred, BLOCKERR if we must wait for a sender,
+ *         SYSERR_OTHER on failure
  */
 int recv_any(proc_ctrl_block_t *destproc, void *buffer, unsigned long len) {
     ASSERT(destproc != NULL && buffer != NULL && len > 0);
@@ -109,14 +141,13 @@ int recv_any(proc_ctrl_block_t *destproc, void *buffer, unsigned long len) {
         // Copy message into receiver's buffer
         void *sender_buf = (void*)srcproc->args[1];
         unsigned long sender_len = (unsigned long)srcproc->args[2];
-        unsigned long tocopy_len = MIN(sender_len, len);
-        strncpy(buffer, sender_buf, tocopy_len);
+        int copied = copy_message(buffer, sender_buf, len, sender_len);
 
         // Unblock the sender
         ASSERT_EQUAL(srcproc->curr_state, PROC_STATE_BLOCKED);
-        srcproc->ret = SYSPID_OK;
+        srcproc->ret = copied;
         add_pcb_to_queue(srcproc, PROC_STATE_READY);
-        return SYSPID_OK;
+        return copied;
     } else {
         // Case 2: Wait for sender
         destproc->blocking_queue_name = RECEIVE_ANY;
@@ -124,3 +155,126 @@ int recv_any(proc_ctrl_block_t *destproc, void *buffer, unsigned long len) {
         return BLOCKERR;
     }
 }
+
+/**
+ * Copies a message between two buffers, which must not overlap.
+ * Copies a word at a time with rep movsl, then any leftover bytes.
+ * @param dst - receiver's buffer
+ * @param src - sender's buffer
+ * @param dst_len - length of the receiver's buffer
+ * @param src_len - length of the message in the sender's buffer
+ * @return number of bytes copied
+ */
+static unsigned long copy_message(void *dst, void *src, unsigned long dst_len,
+                                  unsigned long src_len) {
+    unsigned long len = MIN(dst_len, src_len);
+    int ecx, edi, esi;
+
+    __asm__ volatile("cld \n\
+                      rep movsl \n\
+                      movl %6, %%ecx \n\
+                      rep movsb"
+                     : "=&c" (ecx), "=&D" (edi), "=&S" (esi)
+                     : "0" (len >> 2), "1" (dst), "2" (src), "rm" (len & 3)
+                     : "memory");
+
+    return len;
+}
+
+/**
+ * Queues a message in a proc's mailbox. Never blocks.
+ * If the owner is waiting in mbox_recv, it receives the message immediately.
+ * @param srcproc - the process posting the message
+ * @param destproc - the mailbox's owner
+ * @param buffer - buffer containing the data
+ * @param len - length of the data in buffer, at most MBOX_MSG_SIZE
+ * @return bytes posted, SYSMBOX_FULL if the mailbox is full,
+ *         SYSERR_OTHER if a mailbox could not be allocated
+ */
+int post(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
+         void *buffer, unsigned long len) {
+    ASSERT(srcproc != NULL && destproc != NULL && buffer != NULL);
+    ASSERT(0 < len && len <= MBOX_MSG_SIZE);
+
+    // Case 1: Owner is waiting for a message, skip the mailbox
+    if (destproc->curr_state == PROC_STATE_BLOCKED &&
+        destproc->blocking_queue_name == MAILBOX) {
+        int *from_pid = (int*)destproc->args[0];
+        *from_pid = srcproc->pid;
+
+        void *receiver_buf = (void*)destproc->args[1];
+        unsigned long receiver_len = (unsigned long)destproc->args[2];
+        destproc->ret = copy_message(receiver_buf, buffer, receiver_len, len);
+
+        destproc->blocking_queue_name = NO_BLOCKER;
+        add_pcb_to_queue(destproc, PROC_STATE_READY);
+        return len;
+    }
+
+    // Case 2: Queue the message until the owner asks for it
+    mailbox_t *mbox = destproc->mailbox;
+    if (mbox == NULL) {
+        mbox = kmalloc(sizeof(mailbox_t));
+        if (mbox == NULL) {
+            return SYSERR_OTHER;
+        }
+
+        mbox->head = 0;
+        mbox->count = 0;
+        destproc->mailbox = mbox;
+    }
+
+    if (mbox->count == MBOX_CAPACITY) {
+        return SYSMBOX_FULL;
+    }
+
+    mbox_msg_t *msg = &mbox->msgs[(mbox->head + mbox->count) % MBOX_CAPACITY];
+    msg->from_pid = srcproc->pid;
+    msg->len = copy_message(msg->data, buffer, MBOX_MSG_SIZE, len);
+    mbox->count++;
+
+    return len;
+}
+
+/**
+ * Takes the oldest message from a proc's own mailbox
+ * @param proc - the mailbox's owner
+ * @param from_pid - set to the pid of the message's poster
+ * @param buffer - buffer to store received data
+ * @param len - length of buffer
+ * @return bytes received, BLOCKERR if the mailbox is empty
+ */
+int mbox_recv(proc_ctrl_block_t *proc, int *from_pid,
+              void *buffer, unsigned long len) {
+    ASSERT(proc != NULL && from_pid != NULL && buffer != NULL && len > 0);
+
+    mailbox_t *mbox = proc->mailbox;
+    if (mbox == NULL || mbox->count == 0) {
+        // Wait for a post
+        proc->blocking_queue_name = MAILBOX;
+        proc->blocking_proc = NULL;
+        return BLOCKERR;
+    }
+
+    mbox_msg_t *msg = &mbox->msgs[mbox->head];
+    *from_pid = msg->from_pid;
+    int copied = copy_message(buffer, msg->data, len, msg->len);
+
+    mbox->head = (mbox->head + 1) % MBOX_CAPACITY;
+    mbox->count--;
+
+    return copied;
+}
+
+/**
+ * Frees a proc's mailbox, along with any messages left in it
+ * @param proc - the mailbox's owner
+ */
+void mbox_free(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    if (proc->mailbox != NULL) {
+        kfree(proc->mailbox);
+        proc->mailbox = NULL;
+    }
+}
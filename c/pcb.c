@@ -16,9 +16,22 @@ Accessible through pcb.h:
   pid_to_proc() - returns the proc with the pid, null otherwise
   get_idleproc() - returns the idle proc
 
-  get_all_proc_info() - fills a list of all procs's pids, statuses, and cpuTimes
+  charge_proc_tick() - counts a tick against a proc, demotes cpu bound procs
+  charge_proc_cycles() - charges user, kernel or interrupt time to a proc
+  set_proc_priority() - sets a proc's base priority, and moves it there
+  set_proc_quantum() - sets how many ticks a proc runs per dispatch
+  quantum_expired() - counts down the running proc's quantum at a tick
+  ready_proc_waiting() - whether a ready proc would run if proc gave way
+  higher_priority_ready() - whether a ready proc should preempt proc
+
+  get_all_proc_info() - fills a batch of procs's pids, statuses, and cpu times
   set_proc_signal() - marks a signal for delivery
-  call_highest_priority_signal() - delivers highest priority signal to process
+  queue_proc_signal() - queues an instance of a signal, with a payload
+  take_proc_signal() - removes one pending instance of a signal
+  take_highest_signal() - removes the highest pending signal of a set
+  deliverable_signals() - pending signals a handler may be run for
+  deliver_signals() - sets a process up to run its pending signals' handlers
+  deliver_signals_as() - deliver_signals, batched or not regardless of build
 
   print_pcb_queue() - prints all blocks in particular queue, testing only
 
@@ -29,21 +42,76 @@ Note:
   manages their own blocked queues. This way, when an event occurs, we can
   quickly find anyone waiting on the event, and address it appropriately.
 
+  The ready queue is a multi-level feedback queue: one FIFO per priority
+  level, plus a bitmap of the non-empty levels, so the highest priority
+  ready proc is found with a single bsf. A proc's level drops by one each
+  time it uses up its level's allotment of cpu time, and every proc is
+  boosted back to its base priority every MLFQ_BOOST_TICKS ticks, so cpu
+  bound procs sink while procs that mostly block stay near the top.
+
+  Each proc has a quantum, in ticks, PROC_QUANTUM_DEFAULT unless changed
+  with syssetquantum. At each tick the running proc keeps the cpu, without
+  going through the ready queue, until its quantum runs out or a proc of
+  higher priority is ready. Batch procs can take long quanta to avoid a
+  context switch every tick. When a quantum runs out, or the proc yields,
+  with no other proc of its priority or higher ready, it simply carries on,
+  skipping the round trip through the ready queue.
+
+  A signal sent by syskill is a bit in signals_fired, so a burst of them
+  collapses into one delivery. syssigqueue instead appends an instance,
+  with a payload word, to the proc's signal queue, and every instance is
+  delivered. Masked signals are left pending for syssigwait, which takes
+  them without running a handler; they neither run a handler nor interrupt
+  a blocked syscall until unmasked. A signal with no handler is dropped,
+  unless it is masked.
+
+  The pcb table grows on demand. The first PCB_CHUNK_SIZE pcbs are static,
+  and whenever the STOPPED queue runs dry another chunk is taken from
+  kmalloc, up to PCB_MAX_CHUNKS chunks. Like slabs, chunks are never handed
+  back. A pid encodes its pcb's slot in the table, (pid - 1) % PCB_MAX_PROCS,
+  so pid_to_proc is still O(1): the slot's high bits index g_pcb_chunks,
+  and its low bits index the chunk.
+
 Further details can be found in the documentation above the function headers.
 */
 
 #include <xeroslib.h>
 #include <xeroskernel.h>
 #include <pcb.h>
+#include <clock.h>
+#include <bitops.h>
+
+// ticks of cpu time a proc may use at level 0 before being demoted,
+// each lower level's allotment is this many ticks longer than the last
+#define MLFQ_ALLOTMENT_TICKS 2
 
-// 2 queues: for processes in READY, STOPPED states
-#define NUM_G_PROC_QUEUES 2
+// ticks between boosts of every proc back to its base priority
+#define MLFQ_BOOST_TICKS 100
+
+// queues for processes in READY state, one per priority, then STOPPED
 proc_ctrl_block_t *g_proc_queue_heads[NUM_G_PROC_QUEUES];
 proc_ctrl_block_t *g_proc_queue_tails[NUM_G_PROC_QUEUES];
-proc_ctrl_block_t g_pcb_table[PCB_TABLE_SIZE];
+proc_ctrl_block_t g_pcb_table[PCB_CHUNK_SIZE];
 proc_ctrl_block_t g_idle_proc;
 
+// g_pcb_table is the first chunk, the rest are allocated by grow_pcb_table
+static proc_ctrl_block_t *g_pcb_chunks[PCB_MAX_CHUNKS];
+static int g_num_pcb_chunks;
+
+// bit n is set if and only if the READY queue of priority n is non-empty
+static unsigned int g_ready_levels;
+static unsigned int g_ticks_since_boost;
+
+static int grow_pcb_table(void);
+static void add_pcb_chunk(proc_ctrl_block_t *chunk);
+static proc_ctrl_block_t* slot_to_proc(int slot);
+static int queue_index(proc_ctrl_block_t *proc);
+static void move_proc_to_priority(proc_ctrl_block_t *proc, int priority);
+static void requeue_ready_proc(proc_ctrl_block_t *proc, int priority);
+static void boost_all_procs(void);
+#if CHECK_LEVEL >= CHECK_FULL
 static void verify_pcb_queues(void);
+#endif
 static void fill_proc_info(processStatuses *ps, int slot,
                            proc_ctrl_block_t *proc);
 
@@ -60,6 +128,20 @@ static void notify_blocked_procs(proc_ctrl_block_t *proc,
 
 static void resolve_blocking(proc_ctrl_block_t *proc);
 
+static int signal_wanted(proc_ctrl_block_t *proc, int signal);
+static int complete_sigwait(proc_ctrl_block_t *proc, int signal,
+                            unsigned long value);
+static void interrupt_blocked_proc(proc_ctrl_block_t *proc, int signal);
+
+// signal instances queued by syssigqueue, oldest first
+typedef struct signal_queue {
+    int count;
+    struct {
+        int signal;
+        unsigned long value;
+    } entries[SIGNAL_QUEUE_SIZE];
+} signal_queue_t;
+
 /**
  * Initializes process queues, process control block table
  */
@@ -67,38 +149,99 @@ void pcb_table_init(void) {
     // assumed throughout
     ASSERT(sizeof(int) * 8 == SIGNAL_TABLE_SIZE);
 
+    // assumed by the ready level bitmap
+    ASSERT(PROC_NUM_PRIORITIES <= sizeof(g_ready_levels) * 8);
+
     // queues for ready and stopped processes
     for (int i = 0; i < NUM_G_PROC_QUEUES; i++) {
         g_proc_queue_heads[i] = NULL;
         g_proc_queue_tails[i] = NULL;
     }
+    g_ready_levels = 0;
+    g_ticks_since_boost = 0;
+
+    for (int i = 0; i < PCB_MAX_CHUNKS; i++) {
+        g_pcb_chunks[i] = NULL;
+    }
+    g_num_pcb_chunks = 0;
+    add_pcb_chunk(g_pcb_table);
+
+    init_idle_proc(&g_idle_proc);
+}
+
+/**
+ * Allocates another chunk of pcbs, and adds them to the STOPPED queue
+ * @return 1 if the table grew, 0 if it is at its limit or out of memory
+ */
+static int grow_pcb_table(void) {
+    if (g_num_pcb_chunks == PCB_MAX_CHUNKS) {
+        DEBUG("PCB table is at its limit!\n");
+        return 0;
+    }
+
+    proc_ctrl_block_t *chunk =
+        kmalloc(PCB_CHUNK_SIZE * sizeof(proc_ctrl_block_t));
+    if (chunk == NULL) {
+        DEBUG("Could not grow the PCB table!\n");
+        return 0;
+    }
+
+    memset(chunk, 0, PCB_CHUNK_SIZE * sizeof(proc_ctrl_block_t));
+    add_pcb_chunk(chunk);
+    return 1;
+}
+
+/**
+ * Makes chunk the next chunk of the pcb table, with all of its pcbs stopped
+ * @param chunk - PCB_CHUNK_SIZE zeroed pcbs
+ */
+static void add_pcb_chunk(proc_ctrl_block_t *chunk) {
+    ASSERT(g_num_pcb_chunks < PCB_MAX_CHUNKS);
+    int first_slot = g_num_pcb_chunks * PCB_CHUNK_SIZE;
+    g_pcb_chunks[g_num_pcb_chunks++] = chunk;
 
     // stopped process queue used to find available pcbs easily
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
+    for (int i = 0; i < PCB_CHUNK_SIZE; i++) {
         // You must set the PID before adding it to the table
         // PID 0 is reserved for idleproc, and cannot be added to any queue
-        g_pcb_table[i].pid = i + 1;
-        add_pcb_to_queue(&g_pcb_table[i], PROC_STATE_STOPPED);
+        chunk[i].pid = first_slot + i + 1;
+        add_pcb_to_queue(&chunk[i], PROC_STATE_STOPPED);
     }
+}
 
-    init_idle_proc(&g_idle_proc);
+/**
+ * Finds the pcb in a slot of the table
+ * @param slot - the slot, 0 to PCB_MAX_PROCS - 1
+ * @return the pcb, or NULL if the slot's chunk has not been allocated
+ */
+static proc_ctrl_block_t* slot_to_proc(int slot) {
+    ASSERT(0 <= slot && slot < PCB_MAX_PROCS);
+
+    proc_ctrl_block_t *chunk = g_pcb_chunks[slot / PCB_CHUNK_SIZE];
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    return &chunk[slot % PCB_CHUNK_SIZE];
 }
 
 /**
- * Removes the next process from the ready queue,
+ * Removes the next process from the highest priority non-empty ready queue,
  * and returns it as a PROC_STATE_RUNNING proc
  * @return: next PCB to be run, set to PROC_STATE_RUNNING
  */
 proc_ctrl_block_t* get_next_proc(void) {
-    proc_ctrl_block_t *proc = g_proc_queue_heads[PROC_STATE_READY];
+    proc_ctrl_block_t *proc;
 
-    if (proc != NULL) {
+    if (g_ready_levels != 0) {
+        proc = g_proc_queue_heads[bit_scan_forward(g_ready_levels)];
         remove_pcb_from_queue(proc);
     } else {
         proc = &g_idle_proc;
     }
 
     proc->curr_state = PROC_STATE_RUNNING;
+    proc->quantum_left = proc->quantum;
     return proc;
 }
 
@@ -109,12 +252,12 @@ proc_ctrl_block_t* get_next_proc(void) {
 proc_ctrl_block_t* get_next_available_pcb(void) {
     // STOPPED queue contains pcbs which are no longer needed,
     // allows us to find a free pcb in constant time.
-    proc_ctrl_block_t *proc = g_proc_queue_heads[PROC_STATE_STOPPED];
-    if (proc == NULL) {
-        DEBUG("PCB table is full!\n");
+    if (g_proc_queue_heads[STOPPED_QUEUE] == NULL && !grow_pcb_table()) {
         return NULL;
     }
 
+    proc_ctrl_block_t *proc = g_proc_queue_heads[STOPPED_QUEUE];
+
     remove_pcb_from_queue(proc);
 
     // save old pid before clearing proc, it is used to calculate the new pid
@@ -124,28 +267,32 @@ proc_ctrl_block_t* get_next_available_pcb(void) {
     // and this also prevents values from leaking
     memset(proc, 0, sizeof(proc_ctrl_block_t));
 
-    proc->signal_table = kmalloc(SIGNAL_TABLE_SIZE * sizeof(funcptr_args1));
+    proc->signal_table = kslab_alloc(SIGNAL_TABLE_SIZE * sizeof(funcptr_args1));
     if (proc->signal_table == NULL) {
         proc->pid = old_pid;
         add_pcb_to_queue(proc, PROC_STATE_STOPPED);
         return NULL;
     }
 
-    memset(proc->signal_table, 0,
-           sizeof(SIGNAL_TABLE_SIZE * sizeof(funcptr_args1)));
+    // signal tables are recycled by kslab, so clear out the old handlers
+    memset(proc->signal_table, 0, SIGNAL_TABLE_SIZE * sizeof(funcptr_args1));
 
     proc->signals_enabled = 1;
 
+    proc->base_priority = PROC_PRIORITY_DEFAULT;
+    proc->priority = PROC_PRIORITY_DEFAULT;
+    proc->quantum = PROC_QUANTUM_DEFAULT;
+
     proc->curr_state = PROC_STATE_STOPPED;
     proc->blocking_queue_name = NO_BLOCKER;
 
     // To allow us to access a proc by its pid in constant time,
-    // we set our pids a multiple of PCB_TABLE_SIZE
-    proc->pid = old_pid + PCB_TABLE_SIZE;
+    // a pcb's pids all differ by multiples of PCB_MAX_PROCS
+    proc->pid = old_pid + PCB_MAX_PROCS;
 
     // by the time we've overflowed, its probably fine to reuse a pid
     if (proc->pid < 1) {
-        proc->pid = old_pid % PCB_TABLE_SIZE;
+        proc->pid = (old_pid - 1) % PCB_MAX_PROCS + 1;
     }
 
     ASSERT(proc->pid >= 1);
@@ -160,8 +307,9 @@ proc_ctrl_block_t* get_next_available_pcb(void) {
  */
 proc_ctrl_block_t* pid_to_proc(int pid) {
     if (pid >= 1) {
-        proc_ctrl_block_t *proc = &g_pcb_table[(pid - 1) % PCB_TABLE_SIZE];
-        if (proc->pid == pid && proc->curr_state != PROC_STATE_STOPPED) {
+        proc_ctrl_block_t *proc = slot_to_proc((pid - 1) % PCB_MAX_PROCS);
+        if (proc != NULL && proc->pid == pid &&
+            proc->curr_state != PROC_STATE_STOPPED) {
             return proc;
         }
     }
@@ -170,32 +318,41 @@ proc_ctrl_block_t* pid_to_proc(int pid) {
 }
 
 /**
- * fills a list of all procs's pids, statuses, and cpuTimes
+ * fills a batch of up to PS_BATCH_SIZE procs's pids, statuses, and cpuTimes.
+ * Sets ps->nextCursor to the cursor of the next batch, or 0 after the last.
  * @param ps - process status block to contain data
- * @return index of final slot filled
+ * @param cursor - 0 for the first batch, otherwise a previous nextCursor
+ * @return number of slots filled
  */
-int get_all_proc_info(processStatuses *ps) {
+int get_all_proc_info(processStatuses *ps, int cursor) {
     ASSERT(ps != NULL);
+    ASSERT(0 <= cursor && cursor <= PCB_MAX_PROCS);
 
-    int slot = 0;
+    int num_filled = 0;
 
-    // idleproc is always added
-    proc_ctrl_block_t* proc = get_idleproc();
-    fill_proc_info(ps, slot, proc);
+    // idleproc is always the first proc,
+    // cursor n > 0 resumes from table slot n - 1
+    if (cursor == 0) {
+        fill_proc_info(ps, num_filled++, get_idleproc());
+    } else {
+        cursor--;
+    }
 
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
-        proc = &g_pcb_table[i];
+    int num_slots = g_num_pcb_chunks * PCB_CHUNK_SIZE;
+    for (; cursor < num_slots && num_filled < PS_BATCH_SIZE; cursor++) {
+        proc_ctrl_block_t *proc = slot_to_proc(cursor);
         if (proc->curr_state != PROC_STATE_STOPPED) {
-            slot++;
-            fill_proc_info(ps, slot, proc);
+            fill_proc_info(ps, num_filled++, proc);
         }
     }
 
-    return slot;
+    ps->nextCursor = (cursor < num_slots) ? cursor + 1 : 0;
+    return num_filled;
 }
 
 /**
- * Marks a signal for delivery
+ * Marks a signal for delivery. Marking a signal that is already pending
+ * has no further effect.
  * @param proc - the process to deliver the signal to
  * @param signal - the signal to deliver
  * @return 0 on success, error code on failure
@@ -207,35 +364,453 @@ int set_proc_signal(proc_ctrl_block_t *proc, int signal) {
         return SYSKILL_INVALID_SIGNAL;
     }
 
-    // NULL signal handler indicates to ignore signal
-    if (proc->signal_table[signal]) {
+    if (complete_sigwait(proc, signal, 0)) {
+        return 0;
+    }
+
+    if (signal_wanted(proc, signal)) {
         FLAG_BIT_SET(proc->signals_fired, signal);
+        interrupt_blocked_proc(proc, signal);
+    }
+
+    return 0;
+}
 
-        if (proc->curr_state == PROC_STATE_BLOCKED) {
-            resolve_blocking(proc);
-            add_pcb_to_queue(proc, PROC_STATE_READY);
+/**
+ * Queues an instance of a signal, carrying a payload, for delivery.
+ * Unlike set_proc_signal, every instance is delivered.
+ * @param proc - the process to deliver the signal to
+ * @param signal - the signal to deliver
+ * @param value - the payload, returned by syssigwait
+ * @return 0 on success, SYSKILL_INVALID_SIGNAL if signal is out of range,
+ *         SYSSIGQUEUE_FULL if proc has SIGNAL_QUEUE_SIZE instances queued,
+ *         SYSERR_OTHER if the queue could not be allocated
+ */
+int queue_proc_signal(proc_ctrl_block_t *proc, int signal,
+                      unsigned long value) {
+    ASSERT(proc != NULL);
+
+    if (signal < 0 || signal >= SIGNAL_TABLE_SIZE) {
+        return SYSKILL_INVALID_SIGNAL;
+    }
+
+    if (complete_sigwait(proc, signal, value) ||
+        !signal_wanted(proc, signal)) {
+        return 0;
+    }
+
+    signal_queue_t *queue = proc->signal_queue;
+    if (queue == NULL) {
+        queue = kmalloc(sizeof(signal_queue_t));
+        if (queue == NULL) {
+            return SYSERR_OTHER;
         }
+
+        queue->count = 0;
+        proc->signal_queue = queue;
     }
 
+    if (queue->count == SIGNAL_QUEUE_SIZE) {
+        return SYSSIGQUEUE_FULL;
+    }
+
+    queue->entries[queue->count].signal = signal;
+    queue->entries[queue->count].value = value;
+    queue->count++;
+
+    FLAG_BIT_SET(proc->signals_queued, signal);
+    interrupt_blocked_proc(proc, signal);
     return 0;
 }
 
 /**
- * delivers highest priority signal to process
- * @param proc - process to deliver a waiting signal to
+ * Removes one pending instance of a signal, the one sent by syskill if
+ * there is one, otherwise the oldest queued one
+ * @param proc - the process the signal is pending for
+ * @param signal - the signal to take
+ * @param[out] value - if not NULL, set to the instance's payload,
+ *                     0 for syskill
+ * @return 1 if an instance was taken, 0 if none was pending
+ */
+int take_proc_signal(proc_ctrl_block_t *proc, int signal,
+                     unsigned long *value) {
+    unsigned long taken = 0;
+
+    if (FLAG_BIT_CHECK(proc->signals_fired, signal)) {
+        FLAG_BIT_CLEAR(proc->signals_fired, signal);
+    } else if (FLAG_BIT_CHECK(proc->signals_queued, signal)) {
+        signal_queue_t *queue = proc->signal_queue;
+        int found = -1;
+        int others = 0;
+
+        for (int i = 0; i < queue->count; i++) {
+            if (queue->entries[i].signal != signal) {
+                continue;
+            }
+            if (found < 0) {
+                found = i;
+            } else {
+                others = 1;
+                break;
+            }
+        }
+        ASSERT(found >= 0);
+
+        taken = queue->entries[found].value;
+        queue->count--;
+        for (int i = found; i < queue->count; i++) {
+            queue->entries[i] = queue->entries[i + 1];
+        }
+
+        if (!others) {
+            FLAG_BIT_CLEAR(proc->signals_queued, signal);
+        }
+    } else {
+        return 0;
+    }
+
+    if (value != NULL) {
+        *value = taken;
+    }
+    return 1;
+}
+
+/**
+ * Removes one pending instance of the highest priority pending signal in
+ * a set, whether it is masked or not
+ * @param proc - the process the signals are pending for
+ * @param set - bitmask of the signals to consider
+ * @param[out] value - if not NULL, set to the instance's payload
+ * @return the signal taken, -1 if none in set is pending
+ */
+int take_highest_signal(proc_ctrl_block_t *proc, unsigned int set,
+                        unsigned long *value) {
+    unsigned int pending = (proc->signals_fired | proc->signals_queued) & set;
+    if (pending == 0) {
+        return -1;
+    }
+
+    int signal = bit_scan_reverse(pending);
+    take_proc_signal(proc, signal, value);
+    return signal;
+}
+
+/**
+ * Returns the pending signals that are not masked
+ * @param proc - the process the signals are pending for
+ * @return bitmask of the signals
+ */
+unsigned int deliverable_signals(proc_ctrl_block_t *proc) {
+    return (proc->signals_fired | proc->signals_queued) &
+           ~proc->signals_masked;
+}
+
+/**
+ * Whether a signal sent to a proc, which is not waiting for it in
+ * syssigwait, is kept. Signals without a handler are ignored, unless
+ * masked, as then syssigwait may take them later.
+ * @param proc - the process the signal is sent to
+ * @param signal - the signal
+ * @return 1 if the signal is kept, 0 if it is ignored
+ */
+static int signal_wanted(proc_ctrl_block_t *proc, int signal) {
+    return proc->signal_table[signal] != NULL ||
+           FLAG_BIT_CHECK(proc->signals_masked, signal);
+}
+
+/**
+ * Hands a signal straight to a proc blocked in syssigwait, if it is
+ * waiting for it
+ * @param proc - the process the signal is sent to
+ * @param signal - the signal
+ * @param value - the signal's payload
+ * @return 1 if proc took the signal, 0 if it was not waiting for it
+ */
+static int complete_sigwait(proc_ctrl_block_t *proc, int signal,
+                            unsigned long value) {
+    if (proc->curr_state != PROC_STATE_BLOCKED ||
+        proc->blocking_queue_name != SIGWAIT ||
+        !FLAG_BIT_CHECK(proc->args[0], signal)) {
+        return 0;
+    }
+
+    unsigned long *value_ptr = (unsigned long*)proc->args[1];
+    if (value_ptr != NULL) {
+        *value_ptr = value;
+    }
+
+    proc->ret = signal;
+    proc->blocking_queue_name = NO_BLOCKER;
+    add_pcb_to_queue(proc, PROC_STATE_READY);
+    return 1;
+}
+
+/**
+ * Ends the blocking syscall of a proc a signal was just marked for, so
+ * its handler can run, unless the signal is masked
+ * @param proc - the process the signal was marked for
+ * @param signal - the signal
  */
-void call_highest_priority_signal(proc_ctrl_block_t *proc) {
-    ASSERT(proc->signals_fired != 0);
+static void interrupt_blocked_proc(proc_ctrl_block_t *proc, int signal) {
+    if (proc->curr_state == PROC_STATE_BLOCKED &&
+        !FLAG_BIT_CHECK(proc->signals_masked, signal)) {
+        resolve_blocking(proc);
+        add_pcb_to_queue(proc, PROC_STATE_READY);
+    }
+}
 
-    // find highest priority signal. Higher place in table -> higher priority
-    int signal_num = SIGNAL_TABLE_SIZE - 1;
-    while (FLAG_BIT_CHECK(proc->signals_fired, signal_num) == 0) {
-        signal_num--;
+/**
+ * Sets a process up to run the handlers of its pending signals, the next
+ * time it runs, batched if built with SIGNAL_BATCH
+ * @param proc - process to deliver its pending signals to
+ */
+void deliver_signals(proc_ctrl_block_t *proc) {
+    deliver_signals_as(proc, SIGNAL_BATCH);
+}
+
+/**
+ * Sets a process up to run the handlers of its pending signals, the next
+ * time it runs. When batched, every pending instance of every unmasked
+ * signal is delivered at once, and the process makes one syssigreturn for
+ * them all. Otherwise only one instance of the highest priority signal
+ * is, and the rest wait for its syssigreturn.
+ * Higher place in table -> higher priority.
+ * @param proc - process to deliver its pending signals to
+ * @param batch - 1 to deliver them all at once, 0 for one at a time
+ */
+void deliver_signals_as(proc_ctrl_block_t *proc, int batch) {
+    unsigned int signals = deliverable_signals(proc);
+    ASSERT(signals != 0);
+
+    if (batch) {
+        signal_batch(proc->pid, signals);
+        return;
     }
 
-    FLAG_BIT_CLEAR(proc->signals_fired, signal_num);
+    int signal_num = bit_scan_reverse(signals);
+    take_proc_signal(proc, signal_num, NULL);
 
-    signal(proc->pid, signal_num);
+    // the handler may have been removed since the signal was sent
+    if (proc->signal_table[signal_num] != NULL) {
+        signal(proc->pid, signal_num);
+    }
+}
+
+/**
+ * Counts a tick against the proc that was running when the timer fired.
+ * Demotes the proc once it has used up its priority level's allotment,
+ * and periodically boosts every proc back to its base priority.
+ * The proc's cpu time is charged separately, by charge_proc_cycles.
+ * @param proc - the running process
+ */
+void charge_proc_tick(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    // the idle proc is never queued, so has no priority to adjust
+    if (proc->pid != 0) {
+        proc->level_ticks++;
+
+        int allotment = MLFQ_ALLOTMENT_TICKS * (proc->priority + 1);
+        if (proc->level_ticks >= allotment &&
+            proc->priority < PROC_PRIORITY_LOWEST) {
+            move_proc_to_priority(proc, proc->priority + 1);
+        }
+    }
+
+    g_ticks_since_boost++;
+    if (g_ticks_since_boost >= MLFQ_BOOST_TICKS) {
+        boost_all_procs();
+    }
+}
+
+/**
+ * Charges cpu time to a proc
+ * @param proc - the process which used the time
+ * @param kind - whether the time was spent in user code, in the kernel on
+ *               the proc's behalf, or in the kernel handling an interrupt
+ * @param cycles - TSC cycles used
+ */
+void charge_proc_cycles(proc_ctrl_block_t *proc, cpu_time_kind_t kind,
+                        unsigned long long cycles) {
+    ASSERT(proc != NULL);
+
+    switch (kind) {
+    case CPU_TIME_USER:
+        proc->user_cycles += cycles;
+        break;
+
+    case CPU_TIME_KERNEL:
+        proc->kernel_cycles += cycles;
+        break;
+
+    case CPU_TIME_INTR:
+        proc->intr_cycles += cycles;
+        break;
+    }
+}
+
+/**
+ * Sets a proc's base priority, and moves it to that priority
+ * @param proc - the process to change
+ * @param priority - the new base priority
+ * @return 0 on success, SYSPRIO_INVALID_PRIORITY if priority is out of range
+ */
+int set_proc_priority(proc_ctrl_block_t *proc, int priority) {
+    ASSERT(proc != NULL);
+
+    if (priority < PROC_PRIORITY_HIGHEST || priority > PROC_PRIORITY_LOWEST) {
+        return SYSPRIO_INVALID_PRIORITY;
+    }
+
+    proc->base_priority = priority;
+    move_proc_to_priority(proc, priority);
+    return 0;
+}
+
+/**
+ * Sets how many ticks a proc may run each time it is dispatched
+ * @param proc - the process to change
+ * @param ticks - the new quantum
+ * @return 0 on success, SYSQUANTUM_INVALID if ticks is out of range
+ */
+int set_proc_quantum(proc_ctrl_block_t *proc, int ticks) {
+    ASSERT(proc != NULL);
+
+    if (ticks < 1 || ticks > PROC_QUANTUM_MAX) {
+        return SYSQUANTUM_INVALID;
+    }
+
+    proc->quantum = ticks;
+    proc->quantum_left = MIN(proc->quantum_left, ticks);
+    return 0;
+}
+
+/**
+ * Counts a tick off the running proc's quantum
+ * @param proc - the running process
+ * @return 1 if the proc should give up the cpu, because its quantum is used
+ *         up or a higher priority proc is ready, 0 if it keeps running
+ */
+int quantum_expired(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    // the idle proc only runs while nothing else can
+    if (proc->pid == 0) {
+        return ready_proc_waiting(proc);
+    }
+
+    ASSERT_EQUAL(proc->curr_state, PROC_STATE_RUNNING);
+
+    proc->quantum_left--;
+    if (proc->quantum_left > 0) {
+        // charge_proc_tick may also have just demoted proc below a ready proc
+        return higher_priority_ready(proc);
+    }
+
+    // get_next_proc would only pick proc again, so start its next quantum
+    if (!ready_proc_waiting(proc)) {
+        proc->quantum_left = proc->quantum;
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Checks whether any ready proc would run, if proc went to the back of
+ * the ready queue now
+ * @param proc - the running process
+ * @return 1 if a ready proc's priority is as high as proc's, or proc is the
+ *         idle proc and any proc is ready, 0 otherwise
+ */
+int ready_proc_waiting(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    if (g_ready_levels == 0) {
+        return 0;
+    }
+
+    return proc->pid == 0 ||
+        bit_scan_forward(g_ready_levels) <= proc->priority;
+}
+
+/**
+ * Checks whether a ready proc should take the cpu from proc before its
+ * quantum is used up
+ * @param proc - the running process
+ * @return 1 if a ready proc's priority is higher than proc's, or proc is
+ *         the idle proc and any proc is ready, 0 otherwise
+ */
+int higher_priority_ready(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+
+    if (g_ready_levels == 0) {
+        return 0;
+    }
+
+    return proc->pid == 0 ||
+        bit_scan_forward(g_ready_levels) < proc->priority;
+}
+
+/**
+ * Moves a proc to a new priority level, and restarts its allotment there.
+ * If the proc is ready, it moves to the back of the new level's queue.
+ * @param proc - the process to move
+ * @param priority - the new priority level
+ */
+static void move_proc_to_priority(proc_ctrl_block_t *proc, int priority) {
+    ASSERT(proc != NULL && proc->pid != 0);
+    ASSERT(PROC_PRIORITY_HIGHEST <= priority &&
+           priority <= PROC_PRIORITY_LOWEST);
+
+    proc->level_ticks = 0;
+    if (proc->priority == priority) {
+        return;
+    }
+
+    if (proc->curr_state == PROC_STATE_READY) {
+        requeue_ready_proc(proc, priority);
+    } else {
+        proc->priority = priority;
+    }
+}
+
+/**
+ * Moves a ready proc to the back of another priority level's queue.
+ * Unlike add_pcb_to_queue, the proc stays READY throughout.
+ * @param proc - the ready process to move
+ * @param priority - the new priority level
+ */
+static void requeue_ready_proc(proc_ctrl_block_t *proc, int priority) {
+    ASSERT(proc != NULL && proc->pid != 0);
+    ASSERT_EQUAL(proc->curr_state, PROC_STATE_READY);
+
+    remove_pcb_from_queue(proc);
+    proc->priority = priority;
+
+    int queue = queue_index(proc);
+    add_proc_to_queue(proc, &g_proc_queue_heads[queue],
+                      &g_proc_queue_tails[queue]);
+    FLAG_BIT_SET(g_ready_levels, queue);
+
+#if CHECK_LEVEL >= CHECK_FULL
+    verify_pcb_queues();
+#endif
+}
+
+/**
+ * Moves every live proc back to its base priority,
+ * so cpu bound procs demoted to the lowest levels can not starve
+ */
+static void boost_all_procs(void) {
+    g_ticks_since_boost = 0;
+
+    for (int i = 0; i < g_num_pcb_chunks * PCB_CHUNK_SIZE; i++) {
+        proc_ctrl_block_t *proc = slot_to_proc(i);
+        if (proc->curr_state != PROC_STATE_STOPPED) {
+            move_proc_to_priority(proc, proc->base_priority);
+        }
+    }
 }
 
 /**
@@ -247,10 +822,15 @@ void call_highest_priority_signal(proc_ctrl_block_t *proc) {
 static void fill_proc_info(processStatuses *ps, int slot,
                            proc_ctrl_block_t *proc) {
     ASSERT(ps != NULL && proc != NULL);
-    ASSERT(0 <= slot && slot < PCB_TABLE_SIZE);
+    ASSERT(0 <= slot && slot < PS_BATCH_SIZE);
 
     ps->pid[slot] = proc->pid;
-    ps->cpuTime[slot] = proc->cpu_time * TICK_LENGTH_IN_MS;
+    ps->cpuTime[slot] = clock_cycles_to_ms(
+        proc->user_cycles + proc->kernel_cycles + proc->intr_cycles);
+    ps->userTime[slot] = clock_cycles_to_ms(proc->user_cycles);
+    ps->kernelTime[slot] = clock_cycles_to_ms(proc->kernel_cycles);
+    ps->intrTime[slot] = clock_cycles_to_ms(proc->intr_cycles);
+    ps->priority[slot] = proc->priority;
     
     // User wants more detail than our state, they all require blocking details
     int state = proc->curr_state;
@@ -270,12 +850,18 @@ static void fill_proc_info(processStatuses *ps, int slot,
 void cleanup_proc(proc_ctrl_block_t *proc) {
     ASSERT(proc != NULL);
     // memory_region and esp point to two ends of the same block.
-    // memory_region is returned by kmalloc.
+    // memory_region is returned by stackpool_alloc.
     // Because the stack grows down, we set esp to the end of this block.
     // Therefore, in cleanup, we do not free esp, only memory_region
-    kfree(proc->memory_region);
+    stackpool_free(proc->memory_region);
 
-    kfree(proc->signal_table);
+    kslab_free(proc->signal_table);
+    if (proc->signal_queue != NULL) {
+        kfree(proc->signal_queue);
+        proc->signal_queue = NULL;
+    }
+    mbox_free(proc);
+    proc->syscall_ring = NULL;
 
     // all blocked procs on the msg queues must be notified
     notify_blocked_procs(proc, SENDER);
@@ -310,6 +896,8 @@ static void resolve_blocking(proc_ctrl_block_t *proc) {
         break;
 
     case RECEIVE_ANY:
+    case MAILBOX:
+    case SIGWAIT:
     case SENDER:
     case RECEIVER:
         proc->ret = PROC_SIGNALLED;
@@ -335,7 +923,14 @@ static void resolve_blocking(proc_ctrl_block_t *proc) {
         break;
 
     case DEVICE:
+        ASSERT_EQUAL(proc->blocking_proc, NULL);
+        di_cancel_read(proc);
+        proc->blocking_queue_name = NO_BLOCKER;
+        break;
+
     case RECEIVE_ANY:
+    case MAILBOX:
+    case SIGWAIT:
         ASSERT_EQUAL(proc->blocking_proc, NULL);
         proc->blocking_queue_name = NO_BLOCKER;
         break;
@@ -383,7 +978,7 @@ static void notify_blocked_procs(proc_ctrl_block_t *proc,
 void add_pcb_to_queue(proc_ctrl_block_t *proc, proc_state_enum_t new_state) {
     ASSERT(proc != NULL);
     ASSERT(proc->curr_state != new_state);
-    ASSERT(new_state < NUM_G_PROC_QUEUES && new_state >= 0);
+    ASSERT(new_state == PROC_STATE_READY || new_state == PROC_STATE_STOPPED);
 
     proc->curr_state = new_state;
 
@@ -392,10 +987,17 @@ void add_pcb_to_queue(proc_ctrl_block_t *proc, proc_state_enum_t new_state) {
         return;
     }
 
-    add_proc_to_queue(proc, &g_proc_queue_heads[new_state],
-                      &g_proc_queue_tails[new_state]);
+    int queue = queue_index(proc);
+    add_proc_to_queue(proc, &g_proc_queue_heads[queue],
+                      &g_proc_queue_tails[queue]);
+
+    if (new_state == PROC_STATE_READY) {
+        FLAG_BIT_SET(g_ready_levels, queue);
+    }
 
+#if CHECK_LEVEL >= CHECK_FULL
     verify_pcb_queues();
+#endif
 }
 
 /**
@@ -405,14 +1007,21 @@ void add_pcb_to_queue(proc_ctrl_block_t *proc, proc_state_enum_t new_state) {
  */
 void remove_pcb_from_queue(proc_ctrl_block_t *proc) {
     ASSERT(proc != NULL);
-    ASSERT(proc->curr_state != PROC_STATE_RUNNING);
-    ASSERT(proc->curr_state < NUM_G_PROC_QUEUES && proc->curr_state >= 0);
+    ASSERT(proc->curr_state == PROC_STATE_READY ||
+           proc->curr_state == PROC_STATE_STOPPED);
 
-    proc_state_enum_t state = proc->curr_state;
-    remove_proc_from_queue(proc, &g_proc_queue_heads[state],
-                           &g_proc_queue_tails[state]);
+    int queue = queue_index(proc);
+    remove_proc_from_queue(proc, &g_proc_queue_heads[queue],
+                           &g_proc_queue_tails[queue]);
 
+    if (g_proc_queue_heads[queue] == NULL &&
+        proc->curr_state == PROC_STATE_READY) {
+        FLAG_BIT_CLEAR(g_ready_levels, queue);
+    }
+
+#if CHECK_LEVEL >= CHECK_FULL
     verify_pcb_queues();
+#endif
 }
 
 /**
@@ -465,6 +1074,22 @@ int remove_proc_from_blocking_queue(proc_ctrl_block_t *proc,
     return 1;
 }
 
+/**
+ * Finds which of the global queues a READY or STOPPED proc belongs in
+ * @param proc - the process
+ * @return index into g_proc_queue_heads and g_proc_queue_tails
+ */
+static int queue_index(proc_ctrl_block_t *proc) {
+    if (proc->curr_state == PROC_STATE_STOPPED) {
+        return STOPPED_QUEUE;
+    }
+
+    ASSERT_EQUAL(proc->curr_state, PROC_STATE_READY);
+    ASSERT(PROC_PRIORITY_HIGHEST <= proc->priority &&
+           proc->priority <= PROC_PRIORITY_LOWEST);
+    return proc->priority;
+}
+
 /**
  * Adds a proc to the tail of any queue composed of pcbs
  * @param proc - proc to add
@@ -528,6 +1153,24 @@ proc_ctrl_block_t* get_idleproc(void) {
     return &g_idle_proc;
 }
 
+/**
+ * Gets the first proc of a queue, in the order get_next_proc would pick it
+ * @param queue: PROC_STATE_READY or PROC_STATE_STOPPED
+ * @return the first proc in the queue, NULL if it is empty
+ */
+proc_ctrl_block_t* get_pcb_queue_head(proc_state_enum_t queue) {
+    ASSERT(queue == PROC_STATE_READY || queue == PROC_STATE_STOPPED);
+
+    if (queue == PROC_STATE_STOPPED) {
+        return g_proc_queue_heads[STOPPED_QUEUE];
+    }
+
+    if (g_ready_levels == 0) {
+        return NULL;
+    }
+    return g_proc_queue_heads[bit_scan_forward(g_ready_levels)];
+}
+
 /**
  * Debugging function to help print queue contents
  * @param queue: the queue to dump
@@ -535,15 +1178,25 @@ proc_ctrl_block_t* get_idleproc(void) {
 void print_pcb_queue(proc_state_enum_t queue) {
     ASSERT(queue != PROC_STATE_RUNNING);
     ASSERT(queue != PROC_STATE_BLOCKED);
-    proc_ctrl_block_t *curr = g_proc_queue_heads[queue];
+
+    // the ready queue is printed level by level, highest priority first
+    int first = PROC_PRIORITY_HIGHEST;
+    int last = PROC_PRIORITY_LOWEST;
+    if (queue == PROC_STATE_STOPPED) {
+        first = last = STOPPED_QUEUE;
+    }
 
     int count = 0;
 
     DEBUG("Queue %d: ", queue);
-    while(curr != NULL) {
-        kprintf("{PID: %d, state: %d}", curr->pid, curr->curr_state);
-        curr = curr->next_proc;
-        count++;
+    for (int i = first; i <= last; i++) {
+        proc_ctrl_block_t *curr = g_proc_queue_heads[i];
+        while(curr != NULL) {
+            kprintf("{PID: %d, state: %d, prio: %d}",
+                    curr->pid, curr->curr_state, curr->priority);
+            curr = curr->next_proc;
+            count++;
+        }
     }
     kprintf("\n");
 
@@ -554,16 +1207,27 @@ void print_pcb_queue(proc_state_enum_t queue) {
     }
 }
 
+#if CHECK_LEVEL >= CHECK_FULL
 /**
- * Debugging function to sanity check all our PCB queues
+ * Debugging function to sanity check all our PCB queues.
+ * Walks every queue, so only built with CHECK_FULL.
  */
 static void verify_pcb_queues(void) {
     proc_ctrl_block_t *curr;
     for (int i = 0; i < NUM_G_PROC_QUEUES; i++) {
+        int state = (i == STOPPED_QUEUE) ? PROC_STATE_STOPPED
+                                         : PROC_STATE_READY;
+
+        // the ready bitmap must agree with the ready queues
+        if (state == PROC_STATE_READY) {
+            ASSERT_EQUAL(FLAG_BIT_CHECK(g_ready_levels, i),
+                         (g_proc_queue_heads[i] != NULL));
+        }
+
         curr = g_proc_queue_heads[i];
         if (curr != NULL) {
             ASSERT_EQUAL(curr->prev_proc, NULL);
-            ASSERT_EQUAL(curr->curr_state, i);
+            ASSERT_EQUAL(curr->curr_state, state);
 
             if (curr->next_proc) {
                 ASSERT_EQUAL(curr->next_proc->prev_proc, curr);
@@ -571,7 +1235,7 @@ static void verify_pcb_queues(void) {
             }
 
             while(curr->next_proc) {
-                ASSERT_EQUAL(curr->curr_state, i);
+                ASSERT_EQUAL(curr->curr_state, state);
                 ASSERT_EQUAL(curr->prev_proc->next_proc, curr);
                 ASSERT_EQUAL(curr->next_proc->prev_proc, curr);
                 curr = curr->next_proc;
@@ -580,8 +1244,9 @@ static void verify_pcb_queues(void) {
             if (curr->prev_proc) {
                 ASSERT_EQUAL(curr->prev_proc->next_proc, curr);
             }
-            ASSERT_EQUAL(curr->curr_state, i);
+            ASSERT_EQUAL(curr->curr_state, state);
             ASSERT_EQUAL(curr->next_proc, NULL);
         }
     }
 }
+#endif
@@ -2,7 +2,17 @@
 
 Called from outside:
     sigtramp() - executed by process in user space to handle a signal
+    sigtramp_batch() - executed by process in user space to handle signals
     signal() - sets up process stack to execute signal handler via sigtramp
+    signal_batch() - sets up process stack to execute several signal
+                     handlers via sigtramp_batch
+
+Note:
+  Both leave the process's saved return value just below its interrupted
+  context, where syssigreturn restores it from. signal_batch also pushes
+  the handlers, highest priority first, so sigtramp_batch runs them one
+  after another and makes a single syssigreturn, where delivering them one
+  at a time costs a trip into the kernel for each.
 
 Further details can be found in the documentation above the function headers.
 */
@@ -10,6 +20,8 @@ Further details can be found in the documentation above the function headers.
 #include <xeroskernel.h>
 #include <xeroslib.h>
 #include <pcb.h>
+#include <bitops.h>
+
 
 /**
  * Executed by a process in user space to handle a signal
@@ -21,6 +33,19 @@ void sigtramp(funcptr_args1 handler, void* cntx) {
     syssigreturn(cntx);
 }
 
+/**
+ * Executed by a process in user space to handle several signals at once
+ * @param handlers - proc's signal handlers, in the order to run them
+ * @param count - number of handlers
+ * @param cntx - process context at moment of signal
+ */
+void sigtramp_batch(funcptr_args1 *handlers, int count, void *cntx) {
+    for (int i = 0; i < count; i++) {
+        handlers[i](cntx);
+    }
+    syssigreturn(cntx);
+}
+
 /**
  * Sets up a process's stack to execute signal handler via sigtramp
  * @param pid - pid of the proc to signal
@@ -63,3 +88,67 @@ int signal(int pid, int sig_no) {
 
     return 0;
 }
+
+/**
+ * Takes every pending instance of the given signals, and sets up a
+ * process's stack to execute their handlers, highest priority first, via
+ * sigtramp_batch
+ * @param pid - pid of the proc to signal
+ * @param signals - bitmask of the signals to fire
+ * @return 0 on success, error code on failure
+ */
+int signal_batch(int pid, unsigned int signals) {
+    proc_ctrl_block_t* proc = pid_to_proc(pid);
+    if (proc == NULL) {
+        return SYSPID_DNE;
+    }
+
+    int* stack_ptr = (int*)proc->esp;
+
+    // save return value
+    stack_ptr -= 1;
+    *stack_ptr = proc->ret;
+
+    // take every pending instance of the signals, and push a handler for
+    // each, lowest priority first, so the highest priority handler ends up
+    // first in memory
+    int count = 0;
+    while (signals != 0) {
+        int sig_no = bit_scan_forward(signals);
+        FLAG_BIT_CLEAR(signals, sig_no);
+
+        while (take_proc_signal(proc, sig_no, NULL)) {
+            // the handler may have been removed since the signal was sent
+            if (proc->signal_table[sig_no] != NULL) {
+                stack_ptr -= 1;
+                *stack_ptr = (int)proc->signal_table[sig_no];
+                count++;
+            }
+        }
+    }
+    funcptr_args1 *handlers = (funcptr_args1*)stack_ptr;
+
+    // every handler was removed, nothing to run
+    if (count == 0) {
+        return 0;
+    }
+    proc->signals_enabled = 0;
+
+    // push sigtramp_batch's arguments, last first
+    stack_ptr -= 1;
+    *stack_ptr = (int)proc->esp;
+    stack_ptr -= 1;
+    *stack_ptr = count;
+    stack_ptr -= 1;
+    *stack_ptr = (int)handlers;
+
+    // push dummy return address
+    stack_ptr -= 1;
+    *stack_ptr = 0xCAFECAFE;
+
+    proc->esp = (void *)((int)stack_ptr - sizeof(context_frame_t));
+    context_frame_t *new_context = proc->esp;
+    setup_context_frame(new_context, (funcptr)(&sigtramp_batch));
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/* slab.c : size-class allocator for small, fixed size kernel objects
+
+Called from outside:
+  kslab_init() - initializes the size classes
+
+  kslab_alloc() - allocates an object from the smallest class that fits
+  kslab_free() - returns an object allocated by kslab_alloc to its class
+
+  kslab_dump_stats() - prints per-class statistics
+  kslab_get_in_use() - returns objects in use for a class, testing only
+
+Note:
+  Each size class keeps its own LIFO free list of objects, so both allocating
+  and freeing are O(1) in the common case. When a class runs dry, a SLAB_SIZE
+  chunk is taken from kmalloc and carved into objects of that class.
+  Chunks are never handed back to kmalloc; freed objects stay on their class's
+  free list, where they are reused by the next allocation of that class.
+
+  Every object is preceded by a 16 byte slab_object_t header. This keeps
+  objects on 16 byte boundaries like kmalloc, and lets kslab_free find the
+  owning class without being told the object's size.
+
+Further details can be found in the documentation above the function headers.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+
+#define SLAB_SIZE NBPG
+#define SLAB_NUM_CLASSES 5
+#define SLAB_MIN_OBJECT_SIZE 16
+
+typedef struct slab_class slab_class_t;
+
+typedef struct slab_object {
+    /* class this object belongs to, valid for the object's entire lifetime */
+    slab_class_t *cls;
+
+    /* next object in the class's free list, only valid while free */
+    struct slab_object *next;
+
+    unsigned long reserved;
+
+    /* sanity_check and data_start should be equal while allocated */
+    void *sanity_check;
+    unsigned char data_start[];
+} slab_object_t;
+
+struct slab_class {
+    size_t object_size;
+    slab_object_t *free_list;
+
+    int num_slabs;
+    int num_free;
+    int num_in_use;
+    int peak_in_use;
+    unsigned int num_allocs;
+    unsigned int num_frees;
+    unsigned int num_failed;
+};
+
+static slab_class_t g_slab_classes[SLAB_NUM_CLASSES];
+
+static slab_class_t* size_to_class(size_t size);
+static int grow_class(slab_class_t *cls);
+
+/**
+ * Initializes the size classes. Must be called after kmeminit.
+ */
+void kslab_init(void) {
+    // Assumed throughout this file
+    ASSERT_EQUAL(sizeof(slab_object_t), 16);
+
+    // classes are powers of 2: 16, 32, 64, 128, 256
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        memset(&g_slab_classes[i], 0, sizeof(slab_class_t));
+        g_slab_classes[i].object_size = SLAB_MIN_OBJECT_SIZE << i;
+    }
+}
+
+/**
+ * Allocates a small object from the smallest size class that fits.
+ * Returns NULL if size is too large for any class, or memory is exhausted.
+ * @param size - number of bytes to allocate
+ * @return pointer to start of the allocated object
+ */
+void* kslab_alloc(size_t size) {
+    slab_class_t *cls = size_to_class(size);
+    if (cls == NULL) {
+        DEBUG("kslab_alloc has no class for size %d\n", size);
+        return NULL;
+    }
+
+    if (cls->free_list == NULL && !grow_class(cls)) {
+        cls->num_failed++;
+        return NULL;
+    }
+
+    slab_object_t *obj = cls->free_list;
+    cls->free_list = obj->next;
+
+    obj->next = NULL;
+    obj->sanity_check = obj->data_start;
+
+    cls->num_free--;
+    cls->num_in_use++;
+    cls->num_allocs++;
+    cls->peak_in_use = MAX(cls->peak_in_use, cls->num_in_use);
+
+    ASSERT_EQUAL(((size_t)obj->data_start & 0xf), 0);
+    return obj->data_start;
+}
+
+/**
+ * Returns an object previously allocated with kslab_alloc to its class.
+ * @param ptr - start of object returned by kslab_alloc, to be freed
+ */
+void kslab_free(void *ptr) {
+    if (ptr == NULL) {
+        DEBUG("Error: Invalid address 0x%x\n", ptr);
+        return;
+    }
+
+    // We only allocate on 16 byte boundaries
+    ASSERT_EQUAL(((size_t)ptr & 0xf), 0);
+
+    slab_object_t *obj = (slab_object_t*)(ptr - sizeof(slab_object_t));
+    ASSERT_EQUAL(obj->sanity_check, ptr);
+
+    slab_class_t *cls = obj->cls;
+    ASSERT(cls >= g_slab_classes && cls < g_slab_classes + SLAB_NUM_CLASSES);
+
+    // catch double frees
+    obj->sanity_check = NULL;
+
+    obj->next = cls->free_list;
+    cls->free_list = obj;
+
+    cls->num_free++;
+    cls->num_in_use--;
+    cls->num_frees++;
+}
+
+/**
+ * Finds the smallest size class which can hold size bytes
+ * @param size - size of the object
+ * @return the size class, or NULL if the object is too large
+ */
+static slab_class_t* size_to_class(size_t size) {
+    if (size <= 0) {
+        return NULL;
+    }
+
+    // constant number of classes, so this is O(1)
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        if (size <= g_slab_classes[i].object_size) {
+            return &g_slab_classes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Carves a new SLAB_SIZE chunk from kmalloc into objects for the class
+ * @param cls - class to grow
+ * @return 1 if the class was grown, 0 if kmalloc is out of memory
+ */
+static int grow_class(slab_class_t *cls) {
+    size_t slot_size = sizeof(slab_object_t) + cls->object_size;
+
+    unsigned char *slab = kmalloc(SLAB_SIZE);
+    if (slab == NULL) {
+        DEBUG("kslab could not grow class of size %d\n", cls->object_size);
+        return 0;
+    }
+
+    for (size_t offset = 0; offset + slot_size <= SLAB_SIZE;
+         offset += slot_size) {
+        slab_object_t *obj = (slab_object_t*)(slab + offset);
+        obj->cls = cls;
+        obj->sanity_check = NULL;
+        obj->next = cls->free_list;
+        cls->free_list = obj;
+        cls->num_free++;
+    }
+
+    cls->num_slabs++;
+    return 1;
+}
+
+/**
+ * Prints statistics for every size class
+ */
+void kslab_dump_stats(void) {
+    kprintf("size | slabs | in use | peak | free | allocs | frees | failed\n");
+
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab_class_t *cls = &g_slab_classes[i];
+        kprintf("%4d   %5d   %6d   %4d   %4d   %6d   %5d   %6d\n",
+                cls->object_size, cls->num_slabs, cls->num_in_use,
+                cls->peak_in_use, cls->num_free, cls->num_allocs,
+                cls->num_frees, cls->num_failed);
+    }
+}
+
+/**
+ * Returns the number of objects in use in the class that would serve size.
+ * Should only be used for testing.
+ * @param size - an object size served by the class
+ * @return number of objects in use, or -1 if no class serves size
+ */
+int kslab_get_in_use(size_t size) {
+    slab_class_t *cls = size_to_class(size);
+    if (cls == NULL) {
+        return -1;
+    }
+
+    return cls->num_in_use;
+}
@@ -1,17 +1,43 @@
 /* sleep.c : sleep device
 
 Called from outside:
+    sleep_init() - Empties the timer wheel
     sleep() - Puts a process to sleep for a specific amount of time
+    sleep_us() - Like sleep(), to the microsecond
     wake() - Ends the sleep of a process
 
     tick() - Monitors time, so we know when sleeping procs are done.
+    advance_ticks() - Like tick(), for several time slices at once
+    ticks_until_wake() - Time slices until the next sleeping proc wakes
+
+    expire_short_sleepers() - Wakes the short sleepers whose time is up
+    next_short_deadline() - When the first short sleeper wakes
 
 Note:
-  To monitor time efficiently in our sleeping queue, we utilize a delta list.
-  For convenience, time left is stored in proc->ret. This allows us to expand
-  our functionality, while fitting nicely into the current pcb workflow.
-  Additionally, when a process is removed from the list, we have a count of how
-  many time slices were remaining in its sleep.
+  Sleeping procs are kept in a hierarchical timing wheel. Level 0 has a slot
+  for each of the next WHEEL_SLOTS ticks. Each level above has slots
+  WHEEL_SLOTS times as wide, so WHEEL_LEVELS levels cover WHEEL_MAX_TICKS.
+  A proc goes in the lowest level whose range covers its wake tick, in the
+  slot given by that tick's bits for the level, so inserting is O(1).
+  Procs are doubly linked within their slot, and remember which slot that is,
+  so waking one early is O(1) too.
+
+  Each tick expires the level 0 slot for that tick. Whenever level n passes a
+  slot boundary, the next slot of level n+1 comes due, and its procs are
+  re-inserted lower down. Each proc is moved at most WHEEL_LEVELS - 1 times,
+  so tick() is amortized O(1).
+
+  While a proc sleeps, proc->ret holds the tick it wakes on. When it is
+  removed from the wheel, this is replaced with the time remaining in its
+  sleep, in milliseconds, which is 0 if the sleep ran to completion.
+
+  sleep_us sleeps until a TSC deadline, kept in proc->sleep_deadline, rather
+  than for whole ticks. The proc waits in the wheel for the ticks that pass
+  before its deadline, then on the short sleeper list for what is left of
+  the last tick. The short list is sorted by deadline. The dispatcher asks
+  next_short_deadline when the first is due, and programs a one-shot
+  interrupt for it if that is before the next tick. Its time remaining
+  is in microseconds.
 
 Further details can be found in the documentation above the function headers.
 */
@@ -19,12 +45,55 @@ Further details can be found in the documentation above the function headers.
 #include <xeroskernel.h>
 #include <xeroslib.h>
 #include <pcb.h>
+#include <i386.h>
+#include <clock.h>
+#include <bitops.h>
+
+#define WHEEL_LEVELS 6
+#define WHEEL_SLOT_BITS 5
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+#define WHEEL_SLOT_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_TICKS ((1UL << (WHEEL_LEVELS * WHEEL_SLOT_BITS)) - 1)
 
-// sleeping procs, maintained as a delta-list
-proc_ctrl_block_t *g_sleeping_list = NULL;
+// sleep_slot of a proc on the short sleeper list
+#define SLEEP_SLOT_SHORT -1
 
-static void add_to_sleeping_list(proc_ctrl_block_t *proc);
-static void remove_from_sleeping_list(proc_ctrl_block_t *proc);
+// sleeping procs, by level, then by slot
+static proc_ctrl_block_t *g_wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+// bit n of a level is set if and only if its slot n is non-empty
+static unsigned int g_wheel_occupied[WHEEL_LEVELS];
+
+// procs sleeping until a deadline within the current tick, soonest first
+static proc_ctrl_block_t *g_short_sleepers;
+
+// ticks seen by the sleep device since boot, and procs in the wheel
+static unsigned long g_now;
+static int g_num_sleepers;
+
+static void block_proc(proc_ctrl_block_t *proc);
+static void add_deadline(proc_ctrl_block_t *proc);
+static void add_to_wheel(proc_ctrl_block_t *proc);
+static void remove_from_wheel(proc_ctrl_block_t *proc);
+static void add_to_short_list(proc_ctrl_block_t *proc);
+static void remove_from_short_list(proc_ctrl_block_t *proc);
+static void cascade(void);
+static void expire(void);
+static int slots_until_occupied(unsigned int occupied, int slot);
+
+/**
+ * Empties the timer wheel
+ */
+void sleep_init(void) {
+    // slots_until_occupied scans a level's slots as a single word
+    ASSERT_EQUAL(WHEEL_SLOTS, sizeof(unsigned int) * 8);
+
+    memset(g_wheel, 0, sizeof(g_wheel));
+    memset(g_wheel_occupied, 0, sizeof(g_wheel_occupied));
+    g_short_sleepers = NULL;
+    g_now = 0;
+    g_num_sleepers = 0;
+}
 
 /**
  * Puts a process to sleep for a specific amount of time.
@@ -34,12 +103,30 @@ static void remove_from_sleeping_list(proc_ctrl_block_t *proc);
  */
 void sleep(proc_ctrl_block_t *proc, unsigned int time) {
     ASSERT(time > 0);
-    proc->curr_state = PROC_STATE_BLOCKED;
-    proc->blocking_queue_name = SLEEP;
-    proc->blocking_proc = NULL;
+    block_proc(proc);
+    proc->sleep_deadline = 0;
 
-    proc->ret = time / TICK_LENGTH_IN_MS + (time % TICK_LENGTH_IN_MS ? 1 : 0);
-    add_to_sleeping_list(proc);
+    unsigned long ticks =
+        time / TICK_LENGTH_IN_MS + (time % TICK_LENGTH_IN_MS ? 1 : 0);
+    proc->ret = g_now + MIN(ticks, WHEEL_MAX_TICKS);
+
+    add_to_wheel(proc);
+    g_num_sleepers++;
+}
+
+/**
+ * Puts a process to sleep until a number of microseconds have passed,
+ * rather than rounding up to whole ticks.
+ * A process is considered blocked while it is sleeping.
+ * @param proc - the process to sleep
+ * @param time - the time, in microseconds, for the process to sleep
+ */
+void sleep_us(proc_ctrl_block_t *proc, unsigned int time) {
+    ASSERT(time > 0);
+    block_proc(proc);
+
+    proc->sleep_deadline = rdtsc() + MAX(clock_us_to_cycles(time), 1);
+    add_deadline(proc);
 }
 
 /**
@@ -52,86 +139,328 @@ void wake(proc_ctrl_block_t *proc) {
     ASSERT_EQUAL(proc->blocking_proc, NULL);
     ASSERT_EQUAL(proc->blocking_queue_name, SLEEP);
 
-    remove_from_sleeping_list(proc);
+    if (proc->sleep_slot == SLEEP_SLOT_SHORT) {
+        remove_from_short_list(proc);
+    } else {
+        remove_from_wheel(proc);
+        g_num_sleepers--;
+    }
     proc->blocking_queue_name = NO_BLOCKER;
 
-    proc->ret *= TICK_LENGTH_IN_MS;
+    if (proc->sleep_deadline == 0) {
+        proc->ret = ((unsigned long)proc->ret - g_now) * TICK_LENGTH_IN_MS;
+        return;
+    }
+
+    // round up, so a sleep cut short never reports that it completed
+    long long remaining = proc->sleep_deadline - rdtsc();
+    proc->ret = 0;
+    if (remaining > 0) {
+        proc->ret = MAX(clock_cycles_to_us(remaining), 1);
+    }
 }
 
 /**
  * Called at the end of a time slice.
- * Decreases the time each sleeping proc is waiting,
- * removes those that finish, places them on the ready queue
+ * Wakes the sleeping procs whose time is up, places them on the ready queue
  */
 void tick(void) {
-    if (g_sleeping_list == NULL) {
-        return;
+    advance_ticks(1);
+}
+
+/**
+ * Called after several time slices have passed without a tick(),
+ * such as when the timer was left off while idle.
+ * Wakes the sleeping procs whose time is up, places them on the ready queue
+ * @param ticks - number of time slices that have passed
+ */
+void advance_ticks(unsigned int ticks) {
+    while (ticks > 0) {
+        if (g_num_sleepers == 0) {
+            g_now += ticks;
+            return;
+        }
+
+        // nothing wakes or cascades before then, so skip straight to it
+        if (ticks > 1) {
+            unsigned int skip =
+                MIN(ticks, (unsigned int)ticks_until_wake()) - 1;
+            g_now += skip;
+            ticks -= skip;
+        }
+
+        g_now++;
+        ticks--;
+
+        cascade();
+        expire();
+    }
+}
+
+/**
+ * Returns the number of time slices until the next sleeping proc may wake.
+ * This is exact unless the next proc to wake is still in an upper level of
+ * the wheel. Then it is the time until that proc's slot cascades, which
+ * is never later than the proc wakes.
+ * @return time slices until the next wake, -1 if no procs are sleeping
+ */
+int ticks_until_wake(void) {
+    if (g_num_sleepers == 0) {
+        return -1;
     }
 
-    proc_ctrl_block_t *proc;
+    unsigned long ticks = WHEEL_MAX_TICKS;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (g_wheel_occupied[level] == 0) {
+            continue;
+        }
 
-    // subtract 1 time slice, and remove all expired procs
-    g_sleeping_list->ret--;
-    while (g_sleeping_list != NULL && g_sleeping_list->ret <= 0) {
-        // wake may change the value of g_sleeping_list
-        proc = g_sleeping_list;
+        int shift = level * WHEEL_SLOT_BITS;
+        int slot = (g_now >> shift) & WHEEL_SLOT_MASK;
+        unsigned long due = ((g_now >> shift) +
+            slots_until_occupied(g_wheel_occupied[level], slot)) << shift;
+
+        ticks = MIN(ticks, due - g_now);
+    }
+
+    return ticks;
+}
+
+/**
+ * Wakes every short sleeper whose deadline has passed,
+ * places them on the ready queue
+ */
+void expire_short_sleepers(void) {
+    if (g_short_sleepers == NULL) {
+        return;
+    }
+
+    unsigned long long now = rdtsc();
+    while (g_short_sleepers != NULL &&
+           g_short_sleepers->sleep_deadline <= now) {
+        proc_ctrl_block_t *proc = g_short_sleepers;
         wake(proc);
         add_pcb_to_queue(proc, PROC_STATE_READY);
     }
 }
 
 /**
- * Adds the proc to the global sleeping list priority queue
+ * Finds when the first short sleeper wakes
+ * @param[out] deadline - set to the first short sleeper's TSC deadline
+ * @return 1 if there are short sleepers, 0 otherwise
+ */
+int next_short_deadline(unsigned long long *deadline) {
+    if (g_short_sleepers == NULL) {
+        return 0;
+    }
+
+    *deadline = g_short_sleepers->sleep_deadline;
+    return 1;
+}
+
+/**
+ * Marks the proc as blocked on the sleep device
+ * @param proc - the process to sleep
+ */
+static void block_proc(proc_ctrl_block_t *proc) {
+    proc->curr_state = PROC_STATE_BLOCKED;
+    proc->blocking_queue_name = SLEEP;
+    proc->blocking_proc = NULL;
+}
+
+/**
+ * Adds a proc sleeping until proc->sleep_deadline to the wheel, for the
+ * ticks which will pass before then, or to the short list if none will.
  * @param proc - the process to add
  */
-static void add_to_sleeping_list(proc_ctrl_block_t *proc) {
-    ASSERT(proc != NULL);
-    proc_ctrl_block_t *prev = NULL;
-    proc_ctrl_block_t *entry = g_sleeping_list;
-    
-    while (entry != NULL && proc->ret > entry->ret) {
-        proc->ret -= entry->ret;
-        prev = entry;
-        entry = entry->next_proc;
+static void add_deadline(proc_ctrl_block_t *proc) {
+    unsigned long long next_tick = clock_next_tick();
+
+    if (proc->sleep_deadline < next_tick) {
+        add_to_short_list(proc);
+        return;
     }
 
-    if (prev == NULL) {
-        g_sleeping_list = proc;
-    } else {
-        prev->next_proc = proc;
+    unsigned long ticks =
+        clock_cycles_to_ticks(proc->sleep_deadline - next_tick) + 1;
+    proc->ret = g_now + MIN(ticks, WHEEL_MAX_TICKS);
+
+    add_to_wheel(proc);
+    g_num_sleepers++;
+}
+
+/**
+ * Adds the proc to the slot its wake tick falls in, in the lowest level
+ * of the wheel that reaches that far
+ * @param proc - the process to add
+ */
+static void add_to_wheel(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+    unsigned long wake_tick = (unsigned long)proc->ret;
+    unsigned long delta = wake_tick - g_now;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 &&
+           (delta >> ((level + 1) * WHEEL_SLOT_BITS)) != 0) {
+        level++;
     }
-    
-    proc->next_proc = entry;
-    proc->prev_proc = prev;
-    
+    int slot = (wake_tick >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+
+    proc->prev_proc = NULL;
+    proc->next_proc = g_wheel[level][slot];
     if (proc->next_proc != NULL) {
         proc->next_proc->prev_proc = proc;
-        proc->next_proc->ret -= proc->ret;
     }
+
+    g_wheel[level][slot] = proc;
+    FLAG_BIT_SET(g_wheel_occupied[level], slot);
+    proc->sleep_slot = level * WHEEL_SLOTS + slot;
 }
 
 /**
- * Removes the process from the global sleep list.
- * Assumes that proc is in the list
+ * Removes the process from its slot in the wheel.
+ * Assumes that proc is in the wheel
  * @param proc - the process to remove
  */
-static void remove_from_sleeping_list(proc_ctrl_block_t *proc) {
+static void remove_from_wheel(proc_ctrl_block_t *proc) {
     ASSERT(proc != NULL && proc->curr_state == PROC_STATE_BLOCKED);
+    int level = proc->sleep_slot / WHEEL_SLOTS;
+    int slot = proc->sleep_slot % WHEEL_SLOTS;
 
     if (proc->prev_proc) {
         proc->prev_proc->next_proc = proc->next_proc;
+    } else {
+        ASSERT_EQUAL(g_wheel[level][slot], proc);
+        g_wheel[level][slot] = proc->next_proc;
     }
 
     if (proc->next_proc) {
-        proc->next_proc->ret += proc->ret;
         proc->next_proc->prev_proc = proc->prev_proc;
     }
 
-    if (g_sleeping_list == proc) {
-        g_sleeping_list = proc->next_proc;
+    if (g_wheel[level][slot] == NULL) {
+        FLAG_BIT_CLEAR(g_wheel_occupied[level], slot);
+    }
+
+    // done for safety
+    proc->prev_proc = NULL;
+    proc->next_proc = NULL;
+}
+
+/**
+ * Re-inserts the procs of every slot which comes due this tick, lowest
+ * level first. A level's slot comes due when all the levels below it wrap.
+ */
+static void cascade(void) {
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        int shift = level * WHEEL_SLOT_BITS;
+        if ((g_now & ((1UL << shift) - 1)) != 0) {
+            return;
+        }
+
+        int slot = (g_now >> shift) & WHEEL_SLOT_MASK;
+        proc_ctrl_block_t *proc = g_wheel[level][slot];
+        g_wheel[level][slot] = NULL;
+        FLAG_BIT_CLEAR(g_wheel_occupied[level], slot);
+
+        while (proc != NULL) {
+            proc_ctrl_block_t *next = proc->next_proc;
+            add_to_wheel(proc);
+            proc = next;
+        }
+    }
+}
+
+/**
+ * Wakes every proc in this tick's level 0 slot, all of which wake now,
+ * except procs sleeping until a deadline which has not yet passed
+ */
+static void expire(void) {
+    proc_ctrl_block_t **slot = &g_wheel[0][g_now & WHEEL_SLOT_MASK];
+
+    // wake and add_deadline change the value of *slot
+    while (*slot != NULL) {
+        proc_ctrl_block_t *proc = *slot;
+        ASSERT_EQUAL((unsigned long)proc->ret, g_now);
+
+        if (proc->sleep_deadline != 0 && proc->sleep_deadline > rdtsc()) {
+            remove_from_wheel(proc);
+            g_num_sleepers--;
+            add_deadline(proc);
+            continue;
+        }
+
+        wake(proc);
+        add_pcb_to_queue(proc, PROC_STATE_READY);
+    }
+}
+
+/**
+ * Adds the proc to the short list, behind every proc due no later than it
+ * @param proc - the process to add
+ */
+static void add_to_short_list(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL);
+    proc_ctrl_block_t *prev = NULL;
+    proc_ctrl_block_t *next = g_short_sleepers;
+
+    while (next != NULL && next->sleep_deadline <= proc->sleep_deadline) {
+        prev = next;
+        next = next->next_proc;
+    }
+
+    proc->prev_proc = prev;
+    proc->next_proc = next;
+    if (prev != NULL) {
+        prev->next_proc = proc;
+    } else {
+        g_short_sleepers = proc;
+    }
+
+    if (next != NULL) {
+        next->prev_proc = proc;
+    }
+
+    proc->sleep_slot = SLEEP_SLOT_SHORT;
+}
+
+/**
+ * Removes the process from the short list.
+ * Assumes that proc is in the short list
+ * @param proc - the process to remove
+ */
+static void remove_from_short_list(proc_ctrl_block_t *proc) {
+    ASSERT(proc != NULL && proc->curr_state == PROC_STATE_BLOCKED);
+
+    if (proc->prev_proc) {
+        proc->prev_proc->next_proc = proc->next_proc;
+    } else {
+        ASSERT_EQUAL(g_short_sleepers, proc);
+        g_short_sleepers = proc->next_proc;
+    }
+
+    if (proc->next_proc) {
+        proc->next_proc->prev_proc = proc->prev_proc;
     }
 
     // done for safety
     proc->prev_proc = NULL;
     proc->next_proc = NULL;
 }
+
+/**
+ * Counts the slots from slot to the next occupied one, wrapping around
+ * @param occupied - a level's occupancy bits, not 0
+ * @param slot - the level's current slot
+ * @return slots to the next occupied slot, from 1, to WHEEL_SLOTS for slot
+ */
+static int slots_until_occupied(unsigned int occupied, int slot) {
+    int start = (slot + 1) & WHEEL_SLOT_MASK;
+
+    // rotate so the slot after the current one is bit 0
+    if (start != 0) {
+        occupied = (occupied >> start) | (occupied << (WHEEL_SLOTS - start));
+    }
+
+    return bit_scan_forward(occupied) + 1;
+}
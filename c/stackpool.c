@@ -0,0 +1,226 @@
+/* stackpool.c : cache of process stacks, by size class
+
+Called from outside:
+  stackpool_init() - initializes the size classes
+
+  stackpool_alloc() - allocates a stack, reusing a cached one if possible
+  stackpool_free() - returns a stack allocated by stackpool_alloc
+
+  stackpool_dump_stats() - prints per-class statistics
+  stackpool_get_stats() - returns the total cache hits and misses
+
+Note:
+  Every process needs a stack of at least DEFAULT_STACK_SIZE, and most use
+  exactly that. Rather than handing a dead process's stack back to kmalloc,
+  only to search the heap for one the same size at the next create, freed
+  stacks are kept on a LIFO list for their size class. The next create of
+  that class pops it off in O(1). Process signal tables are already recycled
+  the same way by kslab.
+
+  Classes are powers of 2 from DEFAULT_STACK_SIZE, and a stack is rounded up
+  to its class's size. Stacks larger than the largest class bypass the cache.
+  Each class holds at most STACKPOOL_DEPTH stacks, so a burst of processes
+  does not pin memory forever; beyond that, freed stacks go back to kmalloc.
+  If kmalloc runs out, every cached stack is released and the allocation is
+  retried, so the cache never causes a create to fail.
+
+  Every stack is preceded by a 16 byte stack_header_t, which records its
+  class so stackpool_free does not need to be told the size.
+
+Further details can be found in the documentation above the function headers.
+*/
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+#define STACKPOOL_NUM_CLASSES 4
+#define STACKPOOL_DEPTH 8
+
+typedef struct stack_class stack_class_t;
+
+typedef struct stack_header {
+    /* class this stack belongs to, NULL if it bypasses the cache */
+    stack_class_t *cls;
+
+    /* next stack in the class's cache, only valid while cached */
+    struct stack_header *next;
+
+    unsigned long reserved;
+
+    /* sanity_check and data_start should be equal while allocated */
+    void *sanity_check;
+    unsigned char data_start[];
+} stack_header_t;
+
+struct stack_class {
+    size_t stack_size;
+    stack_header_t *cache;
+    int num_cached;
+
+    unsigned int num_hits;
+    unsigned int num_misses;
+    unsigned int num_released;
+};
+
+static stack_class_t g_stack_classes[STACKPOOL_NUM_CLASSES];
+
+static stack_class_t* size_to_class(size_t size);
+static stack_header_t* alloc_stack(size_t size);
+static void release_all_cached(void);
+
+/**
+ * Initializes the size classes. Must be called after kmeminit.
+ */
+void stackpool_init(void) {
+    // Assumed throughout this file
+    ASSERT_EQUAL(sizeof(stack_header_t), 16);
+
+    // classes are DEFAULT_STACK_SIZE times powers of 2: 8K, 16K, 32K, 64K
+    for (int i = 0; i < STACKPOOL_NUM_CLASSES; i++) {
+        memset(&g_stack_classes[i], 0, sizeof(stack_class_t));
+        g_stack_classes[i].stack_size = DEFAULT_STACK_SIZE << i;
+    }
+}
+
+/**
+ * Allocates a stack of at least size bytes, reusing a cached stack of the
+ * same size class if there is one.
+ * @param size - number of bytes of stack needed
+ * @return lowest address of the stack, or NULL if memory is exhausted
+ */
+void* stackpool_alloc(size_t size) {
+    stack_class_t *cls = size_to_class(size);
+    stack_header_t *stack;
+
+    if (cls != NULL && cls->cache != NULL) {
+        stack = cls->cache;
+        cls->cache = stack->next;
+        cls->num_cached--;
+        cls->num_hits++;
+    } else {
+        stack = alloc_stack(cls != NULL ? cls->stack_size : size);
+        if (stack == NULL) {
+            return NULL;
+        }
+
+        stack->cls = cls;
+        if (cls != NULL) {
+            cls->num_misses++;
+        }
+    }
+
+    stack->next = NULL;
+    stack->sanity_check = stack->data_start;
+    return stack->data_start;
+}
+
+/**
+ * Returns a stack allocated by stackpool_alloc, caching it if its class
+ * has room.
+ * @param ptr - lowest address of the stack, as returned by stackpool_alloc
+ */
+void stackpool_free(void *ptr) {
+    if (ptr == NULL) {
+        DEBUG("Error: Invalid address 0x%x\n", ptr);
+        return;
+    }
+
+    stack_header_t *stack = (stack_header_t*)(ptr - sizeof(stack_header_t));
+    ASSERT_EQUAL(stack->sanity_check, ptr);
+
+    // catch double frees
+    stack->sanity_check = NULL;
+
+    stack_class_t *cls = stack->cls;
+    if (cls == NULL || cls->num_cached == STACKPOOL_DEPTH) {
+        if (cls != NULL) {
+            cls->num_released++;
+        }
+        kfree(stack);
+        return;
+    }
+
+    ASSERT(cls >= g_stack_classes &&
+           cls < g_stack_classes + STACKPOOL_NUM_CLASSES);
+
+    stack->next = cls->cache;
+    cls->cache = stack;
+    cls->num_cached++;
+}
+
+/**
+ * Finds the smallest size class which can hold size bytes
+ * @param size - size of the stack
+ * @return the size class, or NULL if the stack is too large to cache
+ */
+static stack_class_t* size_to_class(size_t size) {
+    for (int i = 0; i < STACKPOOL_NUM_CLASSES; i++) {
+        if (size <= g_stack_classes[i].stack_size) {
+            return &g_stack_classes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Allocates a new stack and its header from kmalloc. If the heap is out of
+ * memory, the cache is emptied back into it, and the allocation retried.
+ * @param size - number of bytes of stack
+ * @return the stack's header, or NULL if memory is exhausted
+ */
+static stack_header_t* alloc_stack(size_t size) {
+    stack_header_t *stack = kmalloc(sizeof(stack_header_t) + size);
+    if (stack == NULL) {
+        release_all_cached();
+        stack = kmalloc(sizeof(stack_header_t) + size);
+    }
+
+    return stack;
+}
+
+/**
+ * Hands every cached stack back to kmalloc
+ */
+static void release_all_cached(void) {
+    for (int i = 0; i < STACKPOOL_NUM_CLASSES; i++) {
+        stack_class_t *cls = &g_stack_classes[i];
+
+        while (cls->cache != NULL) {
+            stack_header_t *stack = cls->cache;
+            cls->cache = stack->next;
+            cls->num_cached--;
+            cls->num_released++;
+            kfree(stack);
+        }
+    }
+}
+
+/**
+ * Prints statistics for every size class
+ */
+void stackpool_dump_stats(void) {
+    kprintf(" size | cached | hits | misses | released\n");
+
+    for (int i = 0; i < STACKPOOL_NUM_CLASSES; i++) {
+        stack_class_t *cls = &g_stack_classes[i];
+        kprintf("%5d   %6d   %4d   %6d   %8d\n",
+                cls->stack_size, cls->num_cached, cls->num_hits,
+                cls->num_misses, cls->num_released);
+    }
+}
+
+/**
+ * Returns the cache hits and misses of all classes, since stackpool_init
+ * @param[out] hits - allocations served from the cache
+ * @param[out] misses - allocations of a cacheable size served by kmalloc
+ */
+void stackpool_get_stats(unsigned int *hits, unsigned int *misses) {
+    *hits = 0;
+    *misses = 0;
+
+    for (int i = 0; i < STACKPOOL_NUM_CLASSES; i++) {
+        *hits += g_stack_classes[i].num_hits;
+        *misses += g_stack_classes[i].num_misses;
+    }
+}
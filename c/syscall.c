@@ -9,24 +9,43 @@ Called from user processes:
     sysputs() - allows processes to perform synchronized output
 
     syssleep() - allows process to sleep for a number of milliseconds
+    syssleep_us() - allows process to sleep for a number of microseconds
     syswait() - waits for a process to terminate
-    sysgetcputimes() - fills a processStatuses block with all non-stopped procs
+    sysgetcputimes() - fills a processStatuses block with non-stopped procs
 
     syssend() - sends data to a particular process
     sysrecv() - receives data delivered by syssend()
     syssendbuf() - generalized sysend, for sending > 4 bytes
     sysrecvbuf() - generalized sysrecv, for receiving > 4 bytes
+    syspost() - queues data in a process's mailbox, without blocking
+    sysmbox_recv() - receives data delivered by syspost()
 
     syskill() - delivers a signal to a process
     syssighandler() - registers the handler as a signal handler
     syssigreturn() - restores a process's context after a signal is handled
+    syssigmask() - sets which signals are held back from their handlers
+    syssigqueue() - queues a signal carrying a payload for a process
+    syssigwait() - takes a pending signal without running its handler
 
     sysopen() - open a device
     sysclose() - close a file descriptor
     syswrite() - wrtie to a file descriptor
     sysread() - read from a file descriptor
+    syswritev() - write several buffers to a file descriptor
+    sysreadv() - read from a file descriptor into several buffers
     sysioctl() - execute a device specific control command
 
+    syssetprio() - sets a process's base scheduling priority
+    sysgetprio() - gets a process's current scheduling priority
+    syssetquantum() - sets how many ticks a process runs per turn
+
+    sysring_register() - registers a ring for batching syscalls
+    sysring_prep() - queues a syscall in a ring, without running it
+    sysring_submit() - runs every syscall queued in a ring, with one trap
+
+    sysstat() - fills a syscallStats block with per request counts and latency
+    sysgettime_ns() - returns nanoseconds since boot
+
 
 Helper functions:
     syscallX - prepare stack for syscall with X parameters
@@ -36,7 +55,6 @@ Helper functions:
 #include <xeroskernel.h>
 #include <stdarg.h>
 
-static unsigned long request_reg;
 static int syscall0(int request);
 static int syscall1(int request, unsigned long arg1);
 static int syscall2(int request, unsigned long arg1, unsigned long arg2);
@@ -107,12 +125,11 @@ void sysputs(char *str) {
  * @param dest_pid - pid of process to send to
  * @param buffer - buffer containing data
  * @param len - length of buffer
- * @return 0 on success, -1 if proc terminates or does not exist,
- *         -2 if sending to itself, -3 if any other error.
+ * @return number of bytes received on success, which is less than len if the
+ *         receiver's buffer is smaller. -1 if proc terminates or does not
+ *         exist, -2 if sending to itself, -3 if any other error.
  */
 int syssendbuf(int dest_pid, void *buffer, unsigned long len) {
-    //TODO: should we implement this further,
-    // we either return bytes sent, or len is changed to a ptr and does this
     return syscall3(SYSCALL_SEND, (unsigned long)dest_pid,
                     (unsigned long)buffer, len);
 }
@@ -123,12 +140,11 @@ int syssendbuf(int dest_pid, void *buffer, unsigned long len) {
  *                   (*from_pid will be modified to the PID of the sending proc)
  * @param buffer - buffer to store received data
  * @param len - length of buffer
- * @return 0 on success, -1 if proc terminates or does not exist,
- *         -2 if sending to itself, -3 if any other error.
+ * @return number of bytes received on success, which is less than len if the
+ *         sender's message is shorter. -1 if proc terminates or does not
+ *         exist, -2 if sending to itself, -3 if any other error.
  */
 int sysrecvbuf(int *from_pid, void *buffer, unsigned long len) {
-    //TODO: should we implement this further,
-    // len should be a ptr and set to bytes received
     return syscall3(SYSCALL_RECV, (unsigned long)from_pid,
                     (unsigned long)buffer, len);
 }
@@ -147,7 +163,8 @@ int sysrecvbuf(int *from_pid, void *buffer, unsigned long len) {
  *         -2 if sending to itself, -3 if any other error.
  */
 int syssend(int dest_pid, unsigned long num) {
-    return syssendbuf(dest_pid, &num, sizeof(num));
+    int result = syssendbuf(dest_pid, &num, sizeof(num));
+    return (result < 0) ? result : SYSPID_OK;
 }
 
 /**
@@ -165,7 +182,36 @@ int syssend(int dest_pid, unsigned long num) {
  *         -2 if receiving from itself, -3 if any other error.
  */
 int sysrecv(int *from_pid, unsigned long *num) {
-    return sysrecvbuf(from_pid, (void*)num, sizeof(num));
+    int result = sysrecvbuf(from_pid, (void*)num, sizeof(*num));
+    return (result < 0) ? result : SYSPID_OK;
+}
+
+/**
+ * Queues data in another process's mailbox, without waiting for it to be
+ * received. The receiver collects it with sysmbox_recv().
+ * @param dest_pid - pid of process to post to
+ * @param buffer - buffer containing data
+ * @param len - length of buffer, at most MBOX_MSG_SIZE
+ * @return number of bytes posted on success, -1 if proc does not exist,
+ *         -3 if any other error, -4 if the receiver's mailbox is full.
+ */
+int syspost(int dest_pid, void *buffer, unsigned long len) {
+    return syscall3(SYSCALL_POST, (unsigned long)dest_pid,
+                    (unsigned long)buffer, len);
+}
+
+/**
+ * Receives the oldest message posted to this process's mailbox by syspost().
+ * Blocks if the mailbox is empty.
+ * @param from_pid - set to the pid of the process which posted the message
+ * @param buffer - buffer to store received data
+ * @param len - length of buffer
+ * @return number of bytes received on success, which is less than the
+ *         message's length if buffer is too small. -3 if any other error.
+ */
+int sysmbox_recv(int *from_pid, void *buffer, unsigned long len) {
+    return syscall3(SYSCALL_MBOX_RECV, (unsigned long)from_pid,
+                    (unsigned long)buffer, len);
 }
 
 /**
@@ -178,12 +224,29 @@ unsigned int syssleep(unsigned int milliseconds) {
 }
 
 /**
- * fills a processStatuses block with all non-stopped procs' data
+ * Allows process to sleep for a number of microseconds, rather than
+ * whole timer ticks
+ * @param microseconds - the time to sleep for
+ * @return time requested to sleep for, less time actually slept, in
+ *         microseconds, 0 if the sleep completed
+ */
+unsigned int syssleep_us(unsigned int microseconds) {
+    return syscall1(SYSCALL_SLEEP_US, microseconds);
+}
+
+/**
+ * fills a processStatuses block with up to PS_BATCH_SIZE non-stopped procs'
+ * data. To enumerate every proc, start with cursor 0, then pass ps's
+ * nextCursor to each following call, until nextCursor is 0.
+ * The idle proc is always first in the first batch. Each proc's cpu time is
+ * given in total, and split into user, kernel and interrupt time.
  * @param ps - the process status block to contain the data
- * @return index of final slot filled within each of ps's arrays, -1 on error.
+ * @param cursor - 0, or the nextCursor of the previous batch
+ * @return number of slots filled within each of ps's arrays, -1 on error.
  */
-int sysgetcputimes(processStatuses *ps) {
-    return syscall1(SYSCALL_CPUTIMES, (unsigned long)ps);
+int sysgetcputimes(processStatuses *ps, int cursor) {
+    return syscall2(SYSCALL_CPUTIMES, (unsigned long)ps,
+                    (unsigned long)cursor);
 }
 
 /**
@@ -210,6 +273,50 @@ void syssigreturn(void *old_sp) {
     ASSERT(0);
 }
 
+/**
+ * Sets which signals are masked. A masked signal stays pending, without
+ * running its handler or interrupting a blocked syscall, until it is
+ * unmasked or taken by syssigwait. A masked signal is kept even if it has
+ * no handler.
+ * @param mask - bitmask of the signals to mask, bit n for signal n
+ * @param old_mask - if not NULL, set to the previous mask
+ * @return 0 on success, -3 if old_mask is not a valid address
+ */
+int syssigmask(unsigned int mask, unsigned int *old_mask) {
+    return syscall2(SYSCALL_SIGMASK, (unsigned long)mask,
+                    (unsigned long)old_mask);
+}
+
+/**
+ * Queues a signal for a process, carrying a payload. Unlike syskill,
+ * every signal queued is delivered, even if the same signal is pending.
+ * @param pid - pid of the process to signal
+ * @param signal - number of signal to be delivered
+ * @param value - payload, returned by syssigwait
+ * @return 0 on success, -712 if the process does not exist,
+ *         -651 if the signal is invalid, -5 if the process already has
+ *         SIGNAL_QUEUE_SIZE signals queued, -3 if out of memory
+ */
+int syssigqueue(int pid, int signal, unsigned long value) {
+    return syscall3(SYSCALL_SIGQUEUE, (unsigned long)pid,
+                    (unsigned long)signal, value);
+}
+
+/**
+ * Takes the highest priority pending signal in a set, masked or not,
+ * without running its handler. Blocks until one is sent if none is
+ * pending. Signals outside the set interrupt the wait as usual.
+ * @param set - bitmask of the signals to wait for, bit n for signal n
+ * @param value - if not NULL, set to the signal's payload, 0 if it was
+ *                sent by syskill
+ * @return the signal taken, -3 if set is empty or value is not a valid
+ *         address, -362 if interrupted by a signal outside the set
+ */
+int syssigwait(unsigned int set, unsigned long *value) {
+    return syscall2(SYSCALL_SIGWAIT, (unsigned long)set,
+                    (unsigned long)value);
+}
+
 /**
  * Open a device.
  * @param device_no - the major device number
@@ -253,6 +360,34 @@ int sysread(int fd, void *buf, int buflen) {
         (unsigned long)buflen);
 }
 
+/**
+ * Write several buffers to a file descriptor, in order, with one syscall
+ * @param fd - file descriptor
+ * @param iov - the buffers to write, with their lengths
+ * @param iovcnt - number of buffers in iov, at most IOV_MAX
+ * @return number of bytes written, or -1 on failure. Writing stops at the
+ *         first buffer the device does not write all of
+ */
+int syswritev(int fd, const iovec_t *iov, int iovcnt) {
+    return syscall3(SYSCALL_WRITEV, (unsigned long)fd, (unsigned long)iov,
+        (unsigned long)iovcnt);
+}
+
+/**
+ * Read from a file descriptor into several buffers, filling each in turn,
+ * with one syscall
+ * @param fd - file descriptor
+ * @param iov - the buffers to read into, with their lengths
+ * @param iovcnt - number of buffers in iov, at most IOV_MAX
+ * @return number of bytes read, or -1 on failure. Reading stops at the
+ *         first buffer the device does not fill, so a read of a line may
+ *         leave later buffers untouched
+ */
+int sysreadv(int fd, const iovec_t *iov, int iovcnt) {
+    return syscall3(SYSCALL_READV, (unsigned long)fd, (unsigned long)iov,
+        (unsigned long)iovcnt);
+}
+
 /**
  * Execute special control command.
  * @param fd - file descriptor
@@ -272,6 +407,43 @@ int sysioctl(int fd, unsigned long command, ...) {
     return result;
 }
 
+/**
+ * Sets a process's base scheduling priority, and moves it to that priority.
+ * The scheduler demotes processes below their base priority as they use cpu
+ * time, and periodically boosts them back up to it.
+ * @param pid - process to change, 0 for the calling process
+ * @param priority - PROC_PRIORITY_HIGHEST (0) to PROC_PRIORITY_LOWEST
+ * @return 0 on success, -1 if the process does not exist,
+ *         -2 if priority is out of range
+ */
+int syssetprio(int pid, int priority) {
+    return syscall2(SYSCALL_SETPRIO, (unsigned long)pid,
+                    (unsigned long)priority);
+}
+
+/**
+ * Gets a process's current scheduling priority
+ * @param pid - process to query, 0 for the calling process
+ * @return the process's priority, or -1 if the process does not exist
+ */
+int sysgetprio(int pid) {
+    return syscall1(SYSCALL_GETPRIO, (unsigned long)pid);
+}
+
+/**
+ * Sets how many timer ticks a process may run before others of its priority
+ * get a turn. Longer quanta suit cpu bound batch work, shorter ones suit
+ * interactive work.
+ * @param pid - process to change, 0 for the calling process
+ * @param ticks - the new quantum, from 1 to PROC_QUANTUM_MAX
+ * @return 0 on success, -1 if the process does not exist,
+ *         -2 if ticks is out of range
+ */
+int syssetquantum(int pid, int ticks) {
+    return syscall2(SYSCALL_SETQUANTUM, (unsigned long)pid,
+                    (unsigned long)ticks);
+}
+
 /*****************************************************************************
  * general syscallX functions which prepares the stack for a syscall
  *
@@ -280,79 +452,170 @@ int sysioctl(int fd, unsigned long command, ...) {
  * to pop all of these parameters off the stack so that our stack is back the
  * way it used to be.
  *
- * The syscall return value is stored in %eax. It is moved into request_reg and
- * returned from the syscall.
+ * The syscall return value is left in %eax. The parameters are passed to the
+ * asm as operands rather than read off the frame pointer, so the functions
+ * stay correct when the compiler inlines them or omits the frame pointer.
  *****************************************************************************/
  
 static int syscall0(int request) {
+    int ret;
     __asm__ volatile( " \
-        push 8(%%ebp) \n\
+        push %1 \n\
         int $50 \n\
-        pop request_reg \n\
-        movl %%eax, request_reg \n\
+        addl $4, %%esp \n\
     "
-    : /* no outputs */
-    : /* no range */
-    : "%eax"
+    : "=a" (ret)
+    : "r" (request)
+    : "memory", "cc"
     );
     
-    return (int)request_reg;
+    return ret;
 }
 
 static int syscall1(int request, unsigned long arg1) {
+    int ret;
     __asm__ volatile( " \
-        push 12(%%ebp) \n\
-        push 8(%%ebp) \n\
+        push %2 \n\
+        push %1 \n\
         int $50 \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        movl %%eax, request_reg \n\
+        addl $8, %%esp \n\
     "
-    : /* no outputs */
-    : /* no range */
-    : "%eax"
+    : "=a" (ret)
+    : "r" (request), "r" (arg1)
+    : "memory", "cc"
     );
 
-    return (int)request_reg;
+    return ret;
 }
 
 static int syscall2(int request, unsigned long arg1, unsigned long arg2) {
+    int ret;
     __asm__ volatile( " \
-        push 16(%%ebp) \n\
-        push 12(%%ebp) \n\
-        push 8(%%ebp) \n\
+        push %3 \n\
+        push %2 \n\
+        push %1 \n\
         int $50 \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        movl %%eax, request_reg \n\
+        addl $12, %%esp \n\
     "
-    : /* no outputs */
-    : /* no range */
-    : "%eax"
+    : "=a" (ret)
+    : "r" (request), "r" (arg1), "r" (arg2)
+    : "memory", "cc"
     );
     
-    return (int)request_reg;
+    return ret;
 }
 
 static int syscall3(int request, unsigned long arg1,
                     unsigned long arg2, unsigned long arg3) {
+    int ret;
     __asm__ volatile( " \
-        push 20(%%ebp) \n\
-        push 16(%%ebp) \n\
-        push 12(%%ebp) \n\
-        push 8(%%ebp) \n\
+        push %4 \n\
+        push %3 \n\
+        push %2 \n\
+        push %1 \n\
         int $50 \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        pop request_reg \n\
-        movl %%eax, request_reg \n\
+        addl $16, %%esp \n\
     "
-    : /* no outputs */
-    : /* no range */
-    : "%eax"
+    : "=a" (ret)
+    : "r" (request), "r" (arg1), "r" (arg2), "r" (arg3)
+    : "memory", "cc"
     );
     
-    return (int)request_reg;
+    return ret;
+}
+
+/**
+ * Registers a ring for batching syscalls. The ring is emptied.
+ * A process has at most one ring; registering a new one replaces the old.
+ * @param ring - the ring, or NULL to unregister the current ring
+ * @return 0 on success, -3 if the ring is not a valid address
+ */
+int sysring_register(syscall_ring_t *ring) {
+    return syscall1(SYSCALL_RING_REGISTER, (unsigned long)ring);
+}
+
+/**
+ * Queues a syscall in a ring. Nothing is run until sysring_submit().
+ * Unused arguments are ignored.
+ * @param ring - a ring registered with sysring_register()
+ * @param request - the syscall, e.g. SYSCALL_SEND
+ * @param arg1 - the syscall's first argument
+ * @param arg2 - the syscall's second argument
+ * @param arg3 - the syscall's third argument
+ * @return index of the entry the syscall's result will be stored in,
+ *         or -1 if the ring is full
+ */
+int sysring_prep(syscall_ring_t *ring, syscall_request_id_t request,
+                 unsigned long arg1, unsigned long arg2, unsigned long arg3) {
+    if (ring->tail - ring->head >= SYSCALL_RING_SIZE) {
+        return -1;
+    }
+
+    int index = ring->tail % SYSCALL_RING_SIZE;
+    syscall_ring_entry_t *entry = &ring->entries[index];
+    entry->request = request;
+    entry->args[0] = arg1;
+    entry->args[1] = arg2;
+    entry->args[2] = arg3;
+
+    ring->tail++;
+    return index;
+}
+
+/**
+ * Runs every syscall queued in a ring, in order.
+ * Each result is stored in its entry's ret, as the kernel returned it,
+ * e.g. the number of bytes sent for SYSCALL_SEND. Syscalls that cannot be
+ * batched, such as SYSCALL_CREATE, are skipped and their result is -3.
+ * A syscall that blocks costs one more trap; the rest of the ring is
+ * submitted again once it returns.
+ * @param ring - a ring registered with sysring_register()
+ * @return number of syscalls run, or -3 if the ring is not registered
+ */
+int sysring_submit(syscall_ring_t *ring) {
+    unsigned int start = ring->head;
+
+    while (ring->head != ring->tail) {
+        // only set by the kernel when an entry blocks, so it must not hold
+        // an index left over from before, or garbage if never registered
+        ring->blocked = -1;
+
+        int result = syscall1(SYSCALL_RING_SUBMIT, (unsigned long)ring);
+        if (ring->blocked < 0) {
+            // nothing blocked, so a negative result is the ring's rejection.
+            // A blocked entry's own result may be negative too, and is kept.
+            if (result < 0) {
+                return result;
+            }
+            continue;
+        }
+
+        // the blocked syscall's result is the trap's return value
+        ring->entries[ring->blocked].ret = result;
+        ring->blocked = -1;
+    }
+
+    return ring->head - start;
+}
+
+/**
+ * Fills a syscallStats block with how often each request, syscalls as well
+ * as timer and keyboard interrupts, has been handled and how many cpu cycles
+ * handling it took, both as min/avg/max and as a histogram of power of two
+ * buckets. Arrays are indexed by syscall_request_id_t.
+ * @param stats - the block to contain the data
+ * @param reset - if nonzero, the kernel's statistics are cleared afterwards
+ * @return number of requests filled in, or -3 if stats is invalid
+ */
+int sysstat(syscallStats *stats, int reset) {
+    return syscall2(SYSCALL_STAT, (unsigned long)stats, (unsigned long)reset);
+}
+
+/**
+ * Reads the kernel's clock, which is calibrated at boot
+ * @param ns - set to the nanoseconds since boot
+ * @return 0 on success, or -3 if ns is invalid
+ */
+int sysgettime_ns(unsigned long long *ns) {
+    return syscall1(SYSCALL_GETTIME_NS, (unsigned long)ns);
 }
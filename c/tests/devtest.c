@@ -14,6 +14,8 @@ static void devtest_open_close(void);
 static void devtest_write(void);
 static void devtest_read(void);
 static void devtest_read_ioctl(void);
+static void devtest_readv(void);
+static void devtest_readv_err(void);
 static void devtest_read_err(void);
 static void devtest_read_buffer(void);
 static void devtest_read_multi_proc(void);
@@ -27,6 +29,7 @@ static void devtest_read_multi_staggered4(void);
 static void devtest_read_multi_staggered8(void);
 static void devtest_read_multi_staggered(void);
 static void devtest_ioctl(void);
+static void devtest_console(void);
 
 #define USER_KILL_SIGNAL 9
 
@@ -38,12 +41,15 @@ void dev_run_all_tests(void) {
     devtest_read();
     devtest_read_err();
     devtest_read_ioctl();
+    devtest_readv();
+    devtest_readv_err();
     devtest_read_buffer();
     devtest_read_multi_kill_cleanup();
     devtest_read_multi();
     devtest_read_buffer_multi();
     devtest_read_multi_staggered();
     devtest_ioctl();
+    devtest_console();
     
     ASSERT_EQUAL(sysopen(DEVICE_ID_KEYBOARD), 0);
     kprintf("Done all device tests. Have fun with the keyboard!\n");
@@ -215,6 +221,65 @@ static void devtest_read_ioctl(void) {
     ASSERT_EQUAL(sysclose(fd), 0);
 }
 
+static void devtest_readv(void) {
+    int fd;
+    int bytes;
+    char first[4 + 1] = {'\0'};
+    char second[8 + 1] = {'\0'};
+    iovec_t iov[3] = {
+        { first, sizeof(first) - 1 },
+        { NULL, 0 },
+        { second, sizeof(second) - 1 }
+    };
+    
+    // Valid case: one read fills both buffers, skipping the empty one
+    kprintf("Please type a line of up to 12 characters\n");
+    fd = sysopen(DEVICE_ID_KEYBOARD);
+    
+    bytes = sysreadv(fd, iov, 3);
+    kprintf("Returned (%d): [%s] [%s]\n", bytes, first, second);
+    ASSERT(bytes >= 0 && bytes <= 12);
+    
+    ASSERT_EQUAL(sysreadv(fd, iov, 0), 0);
+    ASSERT_EQUAL(sysclose(fd), 0);
+}
+
+static void devtest_readv_err(void) {
+    int fd;
+    char buf[4];
+    iovec_t iov[IOV_MAX + 1];
+    
+    for (int i = 0; i < IOV_MAX + 1; i++) {
+        iov[i].iov_base = buf;
+        iov[i].iov_len = sizeof(buf);
+    }
+    
+    kprintf("Invalid: readv and writev with bad iovecs...");
+    fd = sysopen(DEVICE_ID_KEYBOARD);
+    ASSERT_EQUAL(sysreadv(fd, iov, -1), SYSERR);
+    ASSERT_EQUAL(sysreadv(fd, iov, IOV_MAX + 1), SYSERR);
+    ASSERT_EQUAL(sysreadv(fd, NULL, 1), SYSERR);
+    ASSERT_EQUAL(syswritev(fd, iov, IOV_MAX + 1), SYSERR);
+    
+    iov[1].iov_len = -1;
+    ASSERT_EQUAL(sysreadv(fd, iov, 2), SYSERR);
+    iov[1].iov_len = sizeof(buf);
+    iov[1].iov_base = NULL;
+    ASSERT_EQUAL(sysreadv(fd, iov, 2), SYSERR);
+    iov[1].iov_base = buf;
+    kprintf("Success!\n");
+    
+    kprintf("Invalid: writev to the keyboard...");
+    ASSERT_EQUAL(syswritev(fd, iov, 2), SYSERR);
+    kprintf("Success!\n");
+    
+    kprintf("Invalid: readv from closed FD...");
+    ASSERT_EQUAL(sysclose(fd), 0);
+    ASSERT_EQUAL(sysreadv(fd, iov, 1), SYSERR);
+    ASSERT_EQUAL(syswritev(fd, iov, 1), SYSERR);
+    kprintf("Success!\n");
+}
+
 static void devtest_read_multi_proc(void) {
     int pid = sysgetpid();
     int fd;
@@ -232,16 +297,16 @@ static void devtest_read_multi_proc(void) {
 }
 
 static void devtest_read_multi(void) {
-    int pids[PCB_TABLE_SIZE - 1];
+    int pids[PCB_CHUNK_SIZE - 1];
     int numProcs = 0;
     int i;
     
-    for (i = 0; i < PCB_TABLE_SIZE - 1; i++) {
+    for (i = 0; i < PCB_CHUNK_SIZE - 1; i++) {
         pids[i] = syscreate(&devtest_read_multi_proc, DEFAULT_STACK_SIZE);
         numProcs += (pids[i] > 0 ? 1 : 0);
     }
     
-    for (i = 0; i < PCB_TABLE_SIZE - 1; i++) {
+    for (i = 0; i < PCB_CHUNK_SIZE - 1; i++) {
         syswait(pids[i]);
     }
     
@@ -299,7 +364,7 @@ static void devtest_read_buffer_multi_proc(void) {
 }
 
 static void devtest_read_buffer_multi(void) {
-    int pids[PCB_TABLE_SIZE];
+    int pids[PCB_CHUNK_SIZE];
     int numProcs = 0;
     int i;
     
@@ -438,6 +503,34 @@ static void devtest_ioctl(void) {
     ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_ECHO), 0);
     kprintf("Success!\n");
     
+    kprintf("Valid: ioctl to resize the buffer...");
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_BUFFER_SIZE),
+                 KBD_BUFFER_SIZE_DEFAULT);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_DROPPED), 0);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_MAX), 0);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_BUFFER_SIZE),
+                 KBD_BUFFER_SIZE_MAX);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_MIN), 0);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_BUFFER_SIZE),
+                 KBD_BUFFER_SIZE_MIN);
+    kprintf("Success!\n");
+    
+    kprintf("Invalid: ioctl to resize the buffer to a bad size...");
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE, 0), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_MIN + 1), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_MIN / 2), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_MAX * 2), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_BUFFER_SIZE),
+                 KBD_BUFFER_SIZE_MIN);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_SET_BUFFER_SIZE,
+                          KBD_BUFFER_SIZE_DEFAULT), 0);
+    kprintf("Success!\n");
+    
     kprintf("Invalid: ioctl with invalid command code...");
     ASSERT_EQUAL(sysioctl(fd, 1), SYSERR);
     ASSERT_EQUAL(sysioctl(fd, -1), SYSERR);
@@ -462,5 +555,42 @@ static void devtest_ioctl(void) {
     ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_ECHO), SYSERR);
     ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_DISABLE_ECHO), SYSERR);
     ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_ECHO), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_BUFFER_SIZE), SYSERR);
+    kprintf("Success!\n");
+}
+
+static void devtest_console(void) {
+    int fd;
+    int kbd_fd;
+    char buf[4];
+    char line[] = "Written with syswrite\n";
+    char first[] = "Written with ";
+    char second[] = "syswritev\n";
+    iovec_t iov[3] = {
+        { first, sizeof(first) - 1 },
+        { NULL, 0 },
+        { second, sizeof(second) - 1 }
+    };
+    
+    kprintf("Valid: write to the console...\n");
+    fd = sysopen(DEVICE_ID_CONSOLE);
+    ASSERT(fd >= 0);
+    ASSERT_EQUAL(syswrite(fd, line, sizeof(line) - 1), (int)sizeof(line) - 1);
+    ASSERT_EQUAL(syswritev(fd, iov, 3),
+                 (int)(sizeof(first) - 1 + sizeof(second) - 1));
+    ASSERT_EQUAL(syswritev(fd, iov, 0), 0);
+    kprintf("Success!\n");
+    
+    kprintf("Valid: console open with the keyboard...");
+    kbd_fd = sysopen(DEVICE_ID_KEYBOARD);
+    ASSERT(kbd_fd >= 0 && kbd_fd != fd);
+    ASSERT_EQUAL(sysclose(kbd_fd), 0);
+    kprintf("Success!\n");
+    
+    kprintf("Invalid: read and ioctl the console...");
+    ASSERT_EQUAL(sysread(fd, buf, sizeof(buf)), SYSERR);
+    ASSERT_EQUAL(sysioctl(fd, KEYBOARD_IOCTL_GET_ECHO), SYSERR);
+    ASSERT_EQUAL(sysclose(fd), 0);
+    ASSERT_EQUAL(syswrite(fd, line, sizeof(line) - 1), SYSERR);
     kprintf("Success!\n");
 }
@@ -9,40 +9,67 @@ Called from outside:
 #include <xeroskernel.h>
 #include <pcb.h>
 
-static void test_full_table(void);
+static void test_table_growth(void);
 static void test_change_queue(void);
 static void test_get_next_proc(void);
+static void test_priority_order(void);
+static void test_demotion_and_boost(void);
+static void test_quantum(void);
 
 static int create_test_proc(void);
 static void cleanup_queue(proc_state_enum_t queue);
 static void reset_pcb_table(void);
 static void dummy(void);
 
-extern proc_ctrl_block_t g_pcb_table[PCB_TABLE_SIZE];
-extern proc_ctrl_block_t *g_proc_queue_heads[2];
+extern proc_ctrl_block_t g_pcb_table[PCB_CHUNK_SIZE];
 
 /**
  * Runs all dispatcher tests
  */
 void disp_run_all_tests(void){
     test_get_next_proc();
-    test_full_table();
+    test_table_growth();
     test_change_queue();
+    test_priority_order();
+    test_demotion_and_boost();
+    test_quantum();
     DEBUG("Done all queue tests. Looping forever\n");
     while(1);
 }
 
 /**
- * Ensures that we can handle a full pcb table, tests get_next_available_pcb()
+ * Ensures the pcb table grows past its static chunk,
+ * tests get_next_available_pcb() and pid_to_proc()
  */
-static void test_full_table(void) {
-    // Fill up PCB table
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
-        ASSERT(create_test_proc() >= 1);
+static void test_table_growth(void) {
+    int pids[3 * PCB_CHUNK_SIZE];
+
+    for (int i = 0; i < 3 * PCB_CHUNK_SIZE; i++) {
+        pids[i] = create_test_proc();
+        ASSERT(pids[i] >= 1);
+    }
+
+    // every pid still maps straight to its pcb
+    for (int i = 0; i < 3 * PCB_CHUNK_SIZE; i++) {
+        proc_ctrl_block_t *proc = pid_to_proc(pids[i]);
+        ASSERT(proc != NULL);
+        ASSERT_EQUAL(proc->pid, pids[i]);
+    }
+
+    // the last pcbs came from a chunk allocated on demand
+    proc_ctrl_block_t *last = pid_to_proc(pids[3 * PCB_CHUNK_SIZE - 1]);
+    ASSERT(last < g_pcb_table || last >= g_pcb_table + PCB_CHUNK_SIZE);
+
+    reset_pcb_table();
+
+    for (int i = 0; i < 3 * PCB_CHUNK_SIZE; i++) {
+        ASSERT_EQUAL(pid_to_proc(pids[i]), NULL);
     }
 
-    // catch it's full
-    ASSERT_EQUAL(EPROCLIMIT, create_test_proc());
+    // a recycled pcb gets a new pid for the same slot
+    int pid = create_test_proc();
+    ASSERT(pid > PCB_MAX_PROCS);
+    ASSERT(pid_to_proc(pid) != NULL);
 
     reset_pcb_table();
 }
@@ -116,6 +143,127 @@ static void test_get_next_proc(void) {
     reset_pcb_table();
 }
 
+/**
+ * Tests get_next_proc() picks the highest priority, FIFO within a priority
+ */
+static void test_priority_order(void) {
+    proc_ctrl_block_t *procs[4];
+    int priorities[4] = {PROC_PRIORITY_LOWEST, PROC_PRIORITY_HIGHEST,
+                         PROC_PRIORITY_LOWEST, PROC_PRIORITY_DEFAULT};
+
+    for (int i = 0; i < 4; i++) {
+        procs[i] = pid_to_proc(create_test_proc());
+        ASSERT_EQUAL(procs[i]->priority, PROC_PRIORITY_DEFAULT);
+        ASSERT_EQUAL(set_proc_priority(procs[i], priorities[i]), 0);
+    }
+
+    ASSERT_EQUAL(set_proc_priority(procs[0], PROC_NUM_PRIORITIES),
+                 SYSPRIO_INVALID_PRIORITY);
+    ASSERT_EQUAL(set_proc_priority(procs[0], -1), SYSPRIO_INVALID_PRIORITY);
+
+    print_pcb_queue(PROC_STATE_READY);
+
+    ASSERT_EQUAL(get_pcb_queue_head(PROC_STATE_READY), procs[1]);
+    ASSERT_EQUAL(get_next_proc(), procs[1]);
+    ASSERT_EQUAL(get_next_proc(), procs[3]);
+    ASSERT_EQUAL(get_next_proc(), procs[0]);
+    ASSERT_EQUAL(get_next_proc(), procs[2]);
+    ASSERT_EQUAL(get_next_proc(), get_idleproc());
+
+    for (int i = 0; i < 4; i++) {
+        cleanup_proc(procs[i]);
+    }
+
+    kprintf("test_priority_order passed!\n");
+}
+
+/**
+ * Tests cpu bound procs are demoted, procs which block are not,
+ * and everything is eventually boosted back to its base priority
+ */
+static void test_demotion_and_boost(void) {
+    proc_ctrl_block_t *hog = pid_to_proc(create_test_proc());
+    proc_ctrl_block_t *sleeper = pid_to_proc(create_test_proc());
+
+    // run the hog until it is demoted, as the timer would
+    int ticks = 0;
+    proc_ctrl_block_t *curr = get_next_proc();
+    ASSERT_EQUAL(curr, hog);
+    while (hog->priority == PROC_PRIORITY_DEFAULT) {
+        charge_proc_tick(hog);
+        ticks++;
+    }
+    ASSERT(ticks > 1);
+    ASSERT_EQUAL(hog->priority, PROC_PRIORITY_DEFAULT + 1);
+    add_pcb_to_queue(hog, PROC_STATE_READY);
+
+    // the proc which never used its allotment now runs first
+    ASSERT_EQUAL(get_next_proc(), sleeper);
+    ASSERT_EQUAL(sleeper->priority, PROC_PRIORITY_DEFAULT);
+    add_pcb_to_queue(sleeper, PROC_STATE_READY);
+
+    // keep the hog running, it sinks to the lowest priority and stays there
+    remove_pcb_from_queue(hog);
+    hog->curr_state = PROC_STATE_RUNNING;
+    for (int i = 0; i < 50 && hog->priority != PROC_PRIORITY_LOWEST; i++) {
+        charge_proc_tick(hog);
+        ASSERT(hog->priority <= PROC_PRIORITY_LOWEST);
+    }
+    ASSERT_EQUAL(hog->priority, PROC_PRIORITY_LOWEST);
+
+    // eventually a boost brings it back up
+    for (int i = 0; i < 200 && hog->priority != PROC_PRIORITY_DEFAULT; i++) {
+        charge_proc_tick(hog);
+    }
+    ASSERT_EQUAL(hog->priority, PROC_PRIORITY_DEFAULT);
+    add_pcb_to_queue(hog, PROC_STATE_READY);
+
+    reset_pcb_table();
+    kprintf("test_demotion_and_boost passed!\n");
+}
+
+/**
+ * Tests a proc keeps the cpu for its whole quantum, unless a higher
+ * priority proc becomes ready
+ */
+static void test_quantum(void) {
+    proc_ctrl_block_t *batch = pid_to_proc(create_test_proc());
+    proc_ctrl_block_t *other = pid_to_proc(create_test_proc());
+    ASSERT_EQUAL(batch->quantum, PROC_QUANTUM_DEFAULT);
+
+    ASSERT_EQUAL(set_proc_quantum(batch, 0), SYSQUANTUM_INVALID);
+    ASSERT_EQUAL(set_proc_quantum(batch, PROC_QUANTUM_MAX + 1),
+                 SYSQUANTUM_INVALID);
+    ASSERT_EQUAL(set_proc_quantum(batch, 3), 0);
+
+    // runs 3 ticks, even though a proc of the same priority is ready
+    ASSERT_EQUAL(get_next_proc(), batch);
+    ASSERT_EQUAL(quantum_expired(batch), 0);
+    ASSERT_EQUAL(quantum_expired(batch), 0);
+    ASSERT_EQUAL(quantum_expired(batch), 1);
+    add_pcb_to_queue(batch, PROC_STATE_READY);
+
+    // the default quantum is used up at once
+    ASSERT_EQUAL(get_next_proc(), other);
+    for (int i = 1; i < PROC_QUANTUM_DEFAULT; i++) {
+        ASSERT_EQUAL(quantum_expired(other), 0);
+    }
+    ASSERT_EQUAL(quantum_expired(other), 1);
+    add_pcb_to_queue(other, PROC_STATE_READY);
+
+    // a higher priority proc cuts the quantum short
+    ASSERT_EQUAL(get_next_proc(), batch);
+    ASSERT_EQUAL(set_proc_priority(other, PROC_PRIORITY_HIGHEST), 0);
+    ASSERT_EQUAL(quantum_expired(batch), 1);
+    add_pcb_to_queue(batch, PROC_STATE_READY);
+
+    // the idle proc gives way to anything
+    ASSERT_EQUAL(quantum_expired(get_idleproc()), 1);
+
+    reset_pcb_table();
+    kprintf("test_quantum passed!\n");
+}
+
 /**
  * Dummy func, for use by create(). Should not be entered.
  */
@@ -135,12 +283,12 @@ static int create_test_proc(void) {
  * Resets queue to original state. Also serves to test cleanup_proc()
  */
 static void cleanup_queue(proc_state_enum_t queue) {
-    proc_ctrl_block_t *curr = g_proc_queue_heads[queue];
+    proc_ctrl_block_t *curr = get_pcb_queue_head(queue);
 
     while(curr != NULL) {
         remove_pcb_from_queue(curr);
         cleanup_proc(curr);
-        curr = g_proc_queue_heads[queue];
+        curr = get_pcb_queue_head(queue);
     }
 }
 
@@ -7,7 +7,9 @@ Called from outside:
 
 #include <xerostest.h>
 #include <xeroskernel.h>
+#include <xeroslib.h>
 #include <i386.h>
+#include <bitops.h>
 #include <stdlib.h>
 #include <limits.h>
 
@@ -18,6 +20,9 @@ static void mem_simple_test_2(void);
 static void mem_stress_test_1(void);
 static void mem_stress_test_2(void);
 static void mem_test_split_coalesce_blocks_1(void);
+static void mem_slab_test_1(void);
+static void mem_stackpool_test_1(void);
+static void mem_policy_comparison(void);
 static void initial_free_list_check(void);
 
 /**
@@ -29,6 +34,9 @@ void mem_run_all_tests(void) {
     mem_stress_test_1();
     mem_stress_test_2();
     mem_test_split_coalesce_blocks_1();
+    mem_policy_comparison();
+    mem_slab_test_1();
+    mem_stackpool_test_1();
     DEBUG("Done all mem tests. Looping forever\n");
     while(1);
 }
@@ -78,8 +86,23 @@ static void mem_simple_test_2(void) {
 static void mem_stress_test_1(void) {
     kprintf("Running mem_stress_test_1\n");
 
-    void *block_2_addr = (void*)0x196010;
-    long block_2_size = 0x269fe0;
+    // the region after the hole runs to the end of memory. It starts with a
+    // 16 byte fencepost and ends with a 16 byte one, and every block has a
+    // 16 byte header and a 4 byte footer
+    void *block_2_addr = (void*)(HOLEEND + 0x20);
+    size_t block_2_free = kmem_maxaddr() + 1 - HOLEEND - 0x20;
+    size_t total, largest;
+    kmem_get_free_stats(&total, &largest);
+    ASSERT_EQUAL(largest, block_2_free);
+
+#if defined(KMEM_POLICY_TLSF)
+    // TLSF rounds requests up to the next size class, so it can only
+    // allocate up to the lower bound of the free block's class, with 16
+    // classes per power of two
+    int msb = bit_scan_reverse(block_2_free);
+    block_2_free &= ~((1 << (msb - 4)) - 1);
+#endif
+    long block_2_size = block_2_free - 0x14;
     void **p2;
 
     for (int i = 0; i < 100; i++) {
@@ -103,15 +126,16 @@ static void mem_test_split_coalesce_blocks_1(void) {
     void *p1 = kmalloc(0x1000);
     void *p2 = kmalloc(0x2000);
 
-    // Initial size of first block should be decreased by 0x3000 + 0x10*2
+    // Initial size of first block should be decreased by 0x3000 + 0x20*2
     // Should see 2 blocks
     kmem_dump_free_list();
     BUSYWAIT();
 
     kfree(p1);
 
-    // Should see 3 blocks - new first one, p1
+    // Should see p1, followed by the shrunken first block, then the rest
     kmem_dump_free_list();
+    ASSERT_EQUAL(kmem_get_free_list_length(), kmem_get_num_regions() + 1);
 
     kfree(p2);
 
@@ -143,7 +167,8 @@ static void mem_stress_test_2(void) {
     }
 
     kmem_dump_free_list();
-    ASSERT_EQUAL(kmem_get_free_list_length(), 1002);
+    ASSERT_EQUAL(kmem_get_free_list_length(),
+                 kmem_get_num_regions() + 1000);
 
     // Free remaining blocks in reverse order
     for (int i = 1999; i >= 1; i-=2) {
@@ -156,11 +181,168 @@ static void mem_stress_test_2(void) {
     kprintf("mem_stress_test_2 passed\n");
 }
 
+/**
+ * Not a pass/fail test. Measures kmalloc latency and heap fragmentation
+ * under a process churn-like mix of stacks and small objects.
+ * Build once with each KMEM_POLICY and compare the output.
+ */
+static void mem_policy_comparison(void) {
+#if defined(KMEM_POLICY_TLSF)
+    kprintf("Running mem_policy_comparison: TLSF\n");
+#else
+    kprintf("Running mem_policy_comparison: FIRST_FIT\n");
+#endif
+    initial_free_list_check();
+
+    void *slots[64] = {0};
+    unsigned long cycles, min_cycles = -1, max_cycles = 0, total_cycles = 0;
+    int num_allocs = 0;
+    size_t size, total_free, largest_free;
+
+    srand(415);
+    for (int round = 0; round < 20000; round++) {
+        int i = rand() % 64;
+        if (slots[i] != NULL) {
+            kfree(slots[i]);
+            slots[i] = NULL;
+            continue;
+        }
+
+        // 1 in 4 allocations is a process stack, the rest are small objects
+        if (rand() % 4 == 0) {
+            size = DEFAULT_STACK_SIZE + (rand() % 4) * DEFAULT_STACK_SIZE;
+        } else {
+            size = 16 + rand() % 512;
+        }
+
+        unsigned long long start = rdtsc();
+        slots[i] = kmalloc(size);
+        cycles = (unsigned long)(rdtsc() - start);
+        ASSERT(slots[i] != NULL);
+
+        num_allocs++;
+        total_cycles += cycles;
+        min_cycles = MIN(min_cycles, cycles);
+        max_cycles = MAX(max_cycles, cycles);
+    }
+
+    kmem_get_free_stats(&total_free, &largest_free);
+    kprintf("kmalloc cycles: min %d, avg %d, max %d over %d allocs\n",
+            min_cycles, total_cycles / num_allocs, max_cycles, num_allocs);
+    kprintf("free blocks: %d, free bytes: 0x%x, largest: 0x%x\n",
+            kmem_get_free_list_length(), total_free, largest_free);
+    kprintf("fragmentation outside largest block: %d%%\n",
+            100 - (int)(largest_free / (total_free / 100)));
+
+    for (int i = 0; i < 64; i++) {
+        if (slots[i] != NULL) {
+            kfree(slots[i]);
+        }
+    }
+
+    initial_free_list_check();
+    kprintf("mem_policy_comparison done\n");
+}
+
+/**
+ * Checks kslab hands out distinct, aligned objects from the right class,
+ * and that freed objects are reused before any new slab is carved.
+ */
+static void mem_slab_test_1(void) {
+    kprintf("Running mem_slab_test_1\n");
+
+    void *ptr_arr[100];
+    int in_use = kslab_get_in_use(128);
+
+    ASSERT_EQUAL(kslab_alloc(0), NULL);
+    ASSERT_EQUAL(kslab_alloc(0x1000), NULL);
+    ASSERT_EQUAL(kslab_get_in_use(0x1000), -1);
+
+    for (int i = 0; i < 100; i++) {
+        ptr_arr[i] = kslab_alloc(128);
+        ASSERT(ptr_arr[i] != NULL);
+        ASSERT_EQUAL(((size_t)ptr_arr[i] & 0xf), 0);
+        if (i > 0) {
+            ASSERT(ptr_arr[i] != ptr_arr[i - 1]);
+        }
+    }
+    ASSERT_EQUAL(kslab_get_in_use(128), in_use + 100);
+
+    // free lists are LIFO, the last object freed is the next one handed out
+    void *last = ptr_arr[99];
+    kslab_free(last);
+    ASSERT_EQUAL(kslab_alloc(100), last);
+
+    for (int i = 0; i < 100; i++) {
+        kslab_free(ptr_arr[i]);
+    }
+    ASSERT_EQUAL(kslab_get_in_use(128), in_use);
+
+    kslab_dump_stats();
+    BUSYWAIT();
+    kprintf("mem_slab_test_1 passed\n");
+}
+
 /**
  * Helper method to check common start/end conditions of tests
  */
 static void initial_free_list_check(void) {
-    ASSERT_EQUAL(kmem_get_free_list_length(), 2);
+    ASSERT_EQUAL(kmem_get_free_list_length(), kmem_get_num_regions());
     kmem_dump_free_list();
     BUSYWAIT();
 }
+
+/**
+ * Checks freed stacks are reused by the next allocation of their class,
+ * and that each class caches a bounded number of stacks.
+ */
+static void mem_stackpool_test_1(void) {
+    kprintf("Running mem_stackpool_test_1\n");
+
+    void *stacks[10];
+    unsigned int hits, misses, old_hits, old_misses;
+    stackpool_get_stats(&old_hits, &old_misses);
+
+    // the first stack of a class comes from kmalloc, then it is reused
+    void *stack = stackpool_alloc(DEFAULT_STACK_SIZE);
+    ASSERT(stack != NULL);
+    ASSERT_EQUAL(((size_t)stack & 0xf), 0);
+    stackpool_free(stack);
+    ASSERT_EQUAL(stackpool_alloc(DEFAULT_STACK_SIZE - 16), stack);
+    stackpool_free(stack);
+
+    stackpool_get_stats(&hits, &misses);
+    ASSERT_EQUAL(hits, old_hits + 1);
+    ASSERT_EQUAL(misses, old_misses + 1);
+
+    // stacks too large for any class are neither hits nor misses
+    stack = stackpool_alloc(DEFAULT_STACK_SIZE * 32);
+    ASSERT(stack != NULL);
+    stackpool_free(stack);
+    stackpool_get_stats(&old_hits, &old_misses);
+    ASSERT_EQUAL(hits, old_hits);
+    ASSERT_EQUAL(misses, old_misses);
+
+    // only some of the freed stacks stay cached
+    for (int i = 0; i < 10; i++) {
+        stacks[i] = stackpool_alloc(2 * DEFAULT_STACK_SIZE);
+        ASSERT(stacks[i] != NULL);
+    }
+    for (int i = 0; i < 10; i++) {
+        stackpool_free(stacks[i]);
+    }
+    for (int i = 0; i < 10; i++) {
+        stacks[i] = stackpool_alloc(2 * DEFAULT_STACK_SIZE);
+    }
+    for (int i = 0; i < 10; i++) {
+        stackpool_free(stacks[i]);
+    }
+
+    stackpool_get_stats(&hits, &misses);
+    ASSERT(hits - old_hits < 10);
+    ASSERT(misses - old_misses > 10);
+
+    stackpool_dump_stats();
+    BUSYWAIT();
+    kprintf("mem_stackpool_test_1 passed\n");
+}
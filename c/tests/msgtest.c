@@ -26,6 +26,8 @@ static void msgtest08_recv_out_of_order(void);
 static void msgtest09_send_to_killed_proc(void);
 static void msgtest10_recv_from_killed_proc(void);
 static void msgtest11_sendbuf(void);
+static void msgtest12_sendbuf_binary(void);
+static void msgtest13_mbox_batch(void);
 
 static int syskill_wrapper(int pid);
 static void msgtest_kill_itself(void);
@@ -46,6 +48,8 @@ void msg_run_all_tests(void) {
     msgtest09_send_to_killed_proc();
     msgtest10_recv_from_killed_proc();
     msgtest11_sendbuf();
+    msgtest12_sendbuf_binary();
+    msgtest13_mbox_batch();
     
     kprintf("Done msg_run_all_tests, looping forever.\n");
     while(1);
@@ -368,13 +372,15 @@ static void msgtest_recvbuf_proc(void) {
     int pid = 0;
     int result;
     
+    // only as much as was sent is received
     result = sysrecvbuf(&pid, (void*)buf, sizeof(buf));
-    ASSERT_EQUAL(result, SYSPID_OK);
+    ASSERT_EQUAL(result, 19);
     DEBUG("\nReceived (%d):\n%s\n", result, buf);
     
+    // only as much as the receiver has room for is sent
     sprintf(buf, "yeah im good it's jUsT A FLESHHHH AHHH~");
     result = syssendbuf(pid, (void*)buf, sizeof(buf));
-    ASSERT_EQUAL(result, SYSPID_OK);
+    ASSERT_EQUAL(result, 19);
 }
 
 static void msgtest11_sendbuf(void) {
@@ -384,12 +390,91 @@ static void msgtest11_sendbuf(void) {
     
     sprintf(buf, "Are you okay?");
     int result = syssendbuf(pid, (void*)buf, sizeof(buf) - 1);
-    ASSERT_EQUAL(result, SYSPID_OK);
+    ASSERT_EQUAL(result, sizeof(buf) - 1);
     
     result  = sysrecvbuf(&pid, (void*)buf, sizeof(buf) - 1);
-    ASSERT_EQUAL(result, SYSPID_OK);
+    ASSERT_EQUAL(result, sizeof(buf) - 1);
     DEBUG("\nReceived (%d):\n%s\n", result, buf);
     
     sysrecv(&pid, &num);
     DEBUG("Done.\n");
 }
+
+// Used by msgtest12_sendbuf_binary, too big for a process stack
+static unsigned char g_binary_buf[4099];
+
+static void msgtest_recvbuf_binary_proc(void) {
+    int pid = 0;
+
+    int result = sysrecvbuf(&pid, g_binary_buf, sizeof(g_binary_buf));
+    ASSERT_EQUAL(result, sizeof(g_binary_buf));
+}
+
+/**
+ * Tests messages are not cut short at NUL bytes, and odd lengths arrive whole
+ */
+static void msgtest12_sendbuf_binary(void) {
+    static unsigned char buf[sizeof(g_binary_buf)];
+    for (int i = 0; i < sizeof(buf); i++) {
+        buf[i] = i % 7 ? i : 0;
+    }
+
+    memset(g_binary_buf, 0xff, sizeof(g_binary_buf));
+    int pid = syscreate(&msgtest_recvbuf_binary_proc, DEFAULT_STACK_SIZE);
+
+    int result = syssendbuf(pid, buf, sizeof(buf));
+    ASSERT_EQUAL(result, sizeof(buf));
+
+    for (int i = 0; i < sizeof(buf); i++) {
+        ASSERT_EQUAL(g_binary_buf[i], buf[i]);
+    }
+
+    kprintf("msgtest12_sendbuf_binary passed!\n");
+}
+
+// Used by msgtest13_mbox_batch
+static int g_mbox_poster_pid;
+
+static void msgtest_mbox_consumer(void) {
+    unsigned long num;
+    int from_pid;
+
+    // one more than fits in the mailbox, the last is posted while we wait
+    for (unsigned long i = 0; i <= MBOX_CAPACITY; i++) {
+        num = 0xDEADBEEF;
+        from_pid = 0;
+        int result = sysmbox_recv(&from_pid, &num, sizeof(num));
+        ASSERT_EQUAL(result, sizeof(num));
+        ASSERT_EQUAL(from_pid, g_mbox_poster_pid);
+        ASSERT_EQUAL(num, i);
+    }
+}
+
+/**
+ * Tests posting fills a mailbox without blocking, messages arrive in order,
+ * and a consumer waiting on an empty mailbox is woken by the next post
+ */
+static void msgtest13_mbox_batch(void) {
+    char too_long[MBOX_MSG_SIZE + 1];
+    unsigned long i;
+
+    g_mbox_poster_pid = sysgetpid();
+    int pid = syscreate(&msgtest_mbox_consumer, DEFAULT_STACK_SIZE);
+    ASSERT(pid >= 1);
+
+    // the consumer has not run yet, so these all queue up
+    for (i = 0; i < MBOX_CAPACITY; i++) {
+        ASSERT_EQUAL(syspost(pid, &i, sizeof(i)), sizeof(i));
+    }
+    ASSERT_EQUAL(syspost(pid, &i, sizeof(i)), SYSMBOX_FULL);
+
+    ASSERT_EQUAL(syspost(pid, too_long, sizeof(too_long)), SYSERR_OTHER);
+    ASSERT_EQUAL(syspost(12345, &i, sizeof(i)), SYSPID_DNE);
+
+    // the consumer empties its mailbox, then waits for the last message
+    sysyield();
+    ASSERT_EQUAL(syspost(pid, &i, sizeof(i)), sizeof(i));
+
+    ASSERT_EQUAL(syswait(pid), 0);
+    kprintf("msgtest13_mbox_batch passed!\n");
+}
@@ -6,12 +6,15 @@ Called from outside:
 
 #include <xerostest.h>
 #include <xeroskernel.h>
+#include <pcb.h>
 
 // Tests
 static void signaltest_syskill(void);
 static void signaltest_syshandler(void);
 static void signaltest_signal_priorities(void);
 static void signaltest_signal_blocked(void);
+static void signaltest_sigmask(void);
+static void signaltest_sigqueue_sigwait(void);
 
 // Helpers
 static void setup_signal_handler(funcptr_args1 newhandler);
@@ -25,6 +28,7 @@ static void medium_pri(void* cntx);
 static void high_pri(void* cntx);
 static void nop_handler(void* cntx);
 static void useless_func(void);
+static void sigwait_proc(void);
 
 static int g_signal_fired = 0;
 
@@ -36,6 +40,8 @@ void signal_run_all_tests(void) {
     signaltest_syshandler();
     signaltest_signal_priorities();
     signaltest_signal_blocked();
+    signaltest_sigmask();
+    signaltest_sigqueue_sigwait();
     DEBUG("Done all signal tests. Looping forever\n");
     while(1);
 }
@@ -106,15 +112,19 @@ static void signaltest_syshandler(void) {
 }
 
 /**
- * Ensures signals fire in priority order
+ * Ensures signals fire in priority order, and with SIGNAL_BATCH that they
+ * take a single syssigreturn
  */
 static void signaltest_signal_priorities(void) {
+    syscallStats stats;
     int pid = syscreate(&test_priorities, DEFAULT_STACK_SIZE);
     ASSERT(pid > 0);
 
     // setup signal handlers
     sysyield();
 
+    ASSERT_EQUAL(sysstat(&stats, 1), NUM_REQUEST_IDS);
+
     kprintf("Sending all 3 signals\n");
     int result = syskill(pid, 0);
     ASSERT_EQUAL(result, 0);
@@ -123,6 +133,9 @@ static void signaltest_signal_priorities(void) {
     result = syskill(pid, 31);
     ASSERT_EQUAL(result, 0);
     sysyield();
+
+    ASSERT_EQUAL(sysstat(&stats, 0), NUM_REQUEST_IDS);
+    ASSERT_EQUAL(stats.count[SYSCALL_SIGRETURN], (SIGNAL_BATCH ? 1 : 3));
 }
 
 /**
@@ -137,6 +150,85 @@ static void signaltest_signal_blocked(void) {
     }
 }
 
+/**
+ * Masked signals wait until they are unmasked
+ */
+static void signaltest_sigmask(void) {
+    funcptr_args1 oldHandler;
+    unsigned int old_mask;
+    g_signal_fired = 0;
+
+    kprintf("Testing masked signals are held back\n");
+    ASSERT_EQUAL(syssighandler(5, &basic_signal_handler, &oldHandler), 0);
+    ASSERT_EQUAL(syssigmask(1 << 5, &old_mask), 0);
+    ASSERT_EQUAL(old_mask, 0);
+
+    ASSERT_EQUAL(syskill(sysgetpid(), 5), 0);
+    sysyield();
+    ASSERT_EQUAL(g_signal_fired, 0);
+
+    // delivered as soon as the unmasking syscall returns
+    ASSERT_EQUAL(syssigmask(0, &old_mask), 0);
+    ASSERT_EQUAL(old_mask, 1 << 5);
+    ASSERT_EQUAL(g_signal_fired, 1);
+
+    ASSERT_EQUAL(syssighandler(5, NULL, &oldHandler), 0);
+}
+
+/**
+ * Queued signals keep every instance and its payload, and syssigwait takes
+ * them without running a handler, or blocks for them
+ */
+static void signaltest_sigqueue_sigwait(void) {
+    unsigned long value;
+    int me = sysgetpid();
+
+    kprintf("Testing syssigqueue and syssigwait\n");
+    ASSERT_EQUAL(syssigqueue(me, 32, 0), SYSKILL_INVALID_SIGNAL);
+    ASSERT_EQUAL(syssigqueue(9999, 7, 0), SYSKILL_TARGET_DNE);
+    ASSERT_EQUAL(syssigwait(0, &value), SYSERR_OTHER);
+
+    // no handlers, so the signals must be masked to be kept
+    ASSERT_EQUAL(syssigmask((1 << 7) | (1 << 9), NULL), 0);
+
+    // highest signal first, then syskill's instance, then oldest first
+    ASSERT_EQUAL(syssigqueue(me, 7, 10), 0);
+    ASSERT_EQUAL(syssigqueue(me, 7, 11), 0);
+    ASSERT_EQUAL(syssigqueue(me, 9, 20), 0);
+    ASSERT_EQUAL(syskill(me, 7), 0);
+    ASSERT_EQUAL(syskill(me, 7), 0);
+
+    ASSERT_EQUAL(syssigwait((1 << 7) | (1 << 9), &value), 9);
+    ASSERT_EQUAL(value, 20);
+    ASSERT_EQUAL(syssigwait(1 << 7, &value), 7);
+    ASSERT_EQUAL(value, 0);
+    ASSERT_EQUAL(syssigwait(1 << 7, &value), 7);
+    ASSERT_EQUAL(value, 10);
+    ASSERT_EQUAL(syssigwait(1 << 7, NULL), 7);
+
+    // the queue is bounded
+    for (int i = 0; i < SIGNAL_QUEUE_SIZE; i++) {
+        ASSERT_EQUAL(syssigqueue(me, 7, i), 0);
+    }
+    ASSERT_EQUAL(syssigqueue(me, 7, 99), SYSSIGQUEUE_FULL);
+    for (int i = 0; i < SIGNAL_QUEUE_SIZE; i++) {
+        ASSERT_EQUAL(syssigwait(1 << 7, &value), 7);
+        ASSERT_EQUAL(value, i);
+    }
+
+    ASSERT_EQUAL(syssigmask(0, NULL), 0);
+
+    // a waiting proc is handed the signal, even without masking it
+    g_signal_fired = 0;
+    int pid = syscreate(&sigwait_proc, DEFAULT_STACK_SIZE);
+    ASSERT(pid > 0);
+    sysyield();
+
+    ASSERT_EQUAL(syssigqueue(pid, 9, 0xCAFE), 0);
+    ASSERT_EQUAL(syswait(pid), 0);
+    ASSERT_EQUAL(g_signal_fired, 0xCAFE);
+}
+
 /**
  * Simple helper to set up newhandler as the lowest priority signal handler
  */
@@ -200,6 +292,12 @@ static void test_blocked(void) {
     ASSERT_EQUAL(sysrecv(&pid, &num), PROC_SIGNALLED);
 }
 
+static void sigwait_proc(void) {
+    unsigned long value;
+    ASSERT_EQUAL(syssigwait(1 << 9, &value), 9);
+    g_signal_fired = value;
+}
+
 static void dummy_proc(void) {
     while(1) {
         sysyield();
@@ -236,12 +334,12 @@ static void nop_handler(void* cntx) {
     // Do some garbage calls, to test we maintain the ret value on the stack
     useless_func();
     processStatuses ps;
-    int num_procs_before = sysgetcputimes(&ps);
+    int num_procs_before = sysgetcputimes(&ps, 0);
     ASSERT_EQUAL(syssend(12345, num_procs_before), SYSPID_DNE);
     ASSERT(sysgetpid() >= 1);
     sysyield();
 }
 
 static void useless_func(void) {
-    for (int i = 0; i < 50; i++);
+    for (volatile int i = 0; i < 50; i++);
 }
@@ -19,6 +19,9 @@ static void syscalltest3_fibonacci_test(void);
 static void test_sysgetpid(void);
 static void test_sysputs(void);
 static void test_syswait(void);
+static void test_sysring(void);
+static void test_sysstat(void);
+static void test_fast_yield(void);
 
 /**
  * Helper functions for test cases
@@ -29,6 +32,8 @@ static void syscall_fibonacci_test_func1(void);
 static void syscall_fibonacci_test_func2(void);
 static void syscall_fibonacci_test_func3(void);
 static void sysgetpid_proc(void);
+static void sysring_receiver(void);
+static void yield_flag_proc(void);
 
 /**
  * Runs all syscall tests
@@ -49,6 +54,12 @@ void syscall_run_all_tests(void) {
     test_sysputs();
 
     test_syswait();
+
+    test_sysring();
+
+    test_sysstat();
+
+    test_fast_yield();
     
     kprintf("Done syscall_run_all_tests, looping forever.\n");
     while(1);
@@ -70,8 +81,9 @@ static void testfunc(void) {
 
 /**
  * Test: Process Bomb
- * Keep creating new processes until we hit the limit.
- * Verify the correct error code is returned
+ * Keep creating new processes until we hit the limit,
+ * which is memory long before PCB_MAX_PROCS.
+ * Verify the correct error code is returned, and the pcb table grew.
  * Clean up the processes afterward.
  */
 static void syscalltest1_create_max_number_of_processes(void) {
@@ -83,8 +95,8 @@ static void syscalltest1_create_max_number_of_processes(void) {
         count++;
     } while (result >= 1);
     kprintf("Result: %d\nSpawned %d processes\n", result, count);
-    ASSERT_EQUAL(result, EPROCLIMIT);
-    ASSERT_EQUAL(count, PCB_TABLE_SIZE);
+    ASSERT(result == ENOMEM || result == EPROCLIMIT);
+    ASSERT(count > PCB_CHUNK_SIZE);
 
     MASS_SYSYIELD();
     kprintf("%s complete\n", __func__);
@@ -261,3 +273,127 @@ static void test_syswait(void) {
     ASSERT_EQUAL(syswait(pid), 0);
     kprintf("returned from wait\n");
 }
+
+static unsigned long sysring_received;
+
+/**
+ * Tests batching syscalls through a syscall ring, including a syscall which
+ * blocks part way through the batch
+ */
+static void test_sysring(void) {
+    kprintf("testing sysring...\n");
+    syscall_ring_t ring;
+    unsigned long num = 415;
+
+    // the ring must be registered first
+    memset(&ring, 0, sizeof(ring));
+    sysring_prep(&ring, SYSCALL_GETPID, 0, 0, 0);
+    ASSERT_EQUAL(sysring_submit(&ring), SYSERR_OTHER);
+    ASSERT_EQUAL(sysring_register(&ring), 0);
+
+    int pid = sysgetpid();
+    int receiver = syscreate(&sysring_receiver, DEFAULT_STACK_SIZE);
+
+    int i_getpid = sysring_prep(&ring, SYSCALL_GETPID, 0, 0, 0);
+    int i_create = sysring_prep(&ring, SYSCALL_CREATE,
+                                (unsigned long)&testfunc, DEFAULT_STACK_SIZE, 0);
+    int i_send = sysring_prep(&ring, SYSCALL_SEND, receiver,
+                              (unsigned long)&num, sizeof(num));
+    int i_sleep = sysring_prep(&ring, SYSCALL_SLEEP, 10, 0, 0);
+    int i_getprio = sysring_prep(&ring, SYSCALL_GETPRIO, 0, 0, 0);
+
+    ASSERT_EQUAL(sysring_submit(&ring), 5);
+    ASSERT_EQUAL(ring.entries[i_getpid].ret, pid);
+    ASSERT_EQUAL(ring.entries[i_create].ret, SYSERR_OTHER);
+    ASSERT_EQUAL(ring.entries[i_send].ret, sizeof(num));
+    ASSERT_EQUAL(ring.entries[i_sleep].ret, 0);
+    ASSERT_EQUAL(ring.entries[i_getprio].ret, sysgetprio(0));
+    ASSERT_EQUAL(sysring_received, 415);
+
+    // a full ring refuses more entries, and wraps around once submitted
+    for (int i = 0; i < SYSCALL_RING_SIZE; i++) {
+        ASSERT(sysring_prep(&ring, SYSCALL_GETPID, 0, 0, 0) >= 0);
+    }
+    ASSERT_EQUAL(sysring_prep(&ring, SYSCALL_GETPID, 0, 0, 0), -1);
+    ASSERT_EQUAL(sysring_submit(&ring), SYSCALL_RING_SIZE);
+    for (int i = 0; i < SYSCALL_RING_SIZE; i++) {
+        ASSERT_EQUAL(ring.entries[i].ret, pid);
+    }
+
+    ASSERT_EQUAL(sysring_register(NULL), 0);
+    sysring_prep(&ring, SYSCALL_GETPID, 0, 0, 0);
+    ASSERT_EQUAL(sysring_submit(&ring), SYSERR_OTHER);
+}
+
+/**
+ * created by test_sysring(), receives the batched send
+ */
+static void sysring_receiver(void) {
+    int from_pid = 0;
+    ASSERT_EQUAL(sysrecv(&from_pid, &sysring_received), SYSPID_OK);
+}
+
+/**
+ * Tests sysstat() counts requests, and orders latencies sensibly
+ */
+static void test_sysstat(void) {
+    kprintf("testing sysstat...\n");
+    syscallStats stats;
+
+    ASSERT_EQUAL(sysstat(NULL, 0), SYSERR_OTHER);
+    ASSERT_EQUAL(sysstat(&stats, 1), NUM_REQUEST_IDS);
+
+    for (int i = 0; i < 5; i++) {
+        sysgetpid();
+    }
+
+    ASSERT_EQUAL(sysstat(&stats, 0), NUM_REQUEST_IDS);
+    ASSERT_EQUAL(stats.count[SYSCALL_GETPID], 5);
+    ASSERT_EQUAL(stats.count[SYSCALL_STAT], 1);
+    ASSERT(stats.minCycles[SYSCALL_GETPID] > 0);
+    ASSERT(stats.minCycles[SYSCALL_GETPID] <= stats.avgCycles[SYSCALL_GETPID]);
+    ASSERT(stats.avgCycles[SYSCALL_GETPID] <= stats.maxCycles[SYSCALL_GETPID]);
+
+    // every request lands in exactly one histogram bucket
+    unsigned long bucketed = 0;
+    for (int b = 0; b < SYSSTAT_HIST_BUCKETS; b++) {
+        bucketed += stats.histogram[SYSCALL_GETPID][b];
+    }
+    ASSERT_EQUAL(bucketed, 5);
+}
+
+static int g_yield_flag;
+
+/**
+ * Tests yields with nothing else to run return without entering the kernel,
+ * and a yield with another proc ready still lets it run
+ */
+static void test_fast_yield(void) {
+    kprintf("testing fast yields...\n");
+    syscallStats stats;
+
+    ASSERT_EQUAL(sysstat(&stats, 1), NUM_REQUEST_IDS);
+    unsigned int fast_before = ctsw_get_fast_yields();
+
+    for (int i = 0; i < 100; i++) {
+        sysyield();
+    }
+
+    ASSERT_EQUAL(ctsw_get_fast_yields() - fast_before, 100);
+    ASSERT_EQUAL(sysstat(&stats, 0), NUM_REQUEST_IDS);
+    ASSERT_EQUAL(stats.count[SYSCALL_YIELD], 0);
+
+    g_yield_flag = 0;
+    int pid = syscreate(&yield_flag_proc, DEFAULT_STACK_SIZE);
+    ASSERT(pid > 0);
+    sysyield();
+    ASSERT_EQUAL(g_yield_flag, 1);
+    ASSERT_EQUAL(syswait(pid), 0);
+}
+
+/**
+ * Helper for test_fast_yield, shows it has run
+ */
+static void yield_flag_proc(void) {
+    g_yield_flag = 1;
+}
@@ -19,8 +19,12 @@ static void test_idleproc(void);
 static void test_sleep1_simple(void);
 static void test_sleep2_killmid(void);
 static void test_sleep3_simultaneous_wake(void);
+static void test_tickless_idle(void);
 static void test_rand_timesharing(void);
 static void test_sysgetcputimes(void);
+static void test_gettime_ns(void);
+static void test_sleep_us(void);
+static void test_cputime_breakdown(void);
 
 /**
  * Helper functions for test cases
@@ -34,6 +38,7 @@ static void sleep10(void);
 static void sleep20(void);
 static void rand_sleep_and_print(void);
 static void cputimehelper(void);
+static void blocks_before_ticks(void);
 static int syskill_wrapper(int pid);
 static void dummy_func(void);
 
@@ -49,11 +54,15 @@ void timer_run_all_tests(void) {
     test_sleep1_simple();
     test_sleep2_killmid();
     test_sleep3_simultaneous_wake();
+    test_tickless_idle();
+    test_gettime_ns();
+    test_sleep_us();
+    test_cputime_breakdown();
     test_idleproc();
 }
 
 // Used in a few tests as a makeshift semaphore
-static int count = 0;
+static volatile int count = 0;
 
 /**
  * Calls termination signal on proc
@@ -240,6 +249,138 @@ static void test_sleep3_simultaneous_wake(void) {
     sysputs("Done test_sleep3_simultaneous_wake\n");
 }
 
+/**
+ * Tests the timer stops ticking while everything sleeps,
+ * without disturbing how long the sleep takes
+ */
+static void test_tickless_idle(void) {
+    processStatuses ps;
+    unsigned int avoided = get_avoided_timer_ints();
+
+    // nothing else is running, so the idle proc covers the whole sleep
+    ASSERT_EQUAL(syssleep(2000), 0);
+
+    // the PIT can cover about 5 ticks per interrupt
+    avoided = get_avoided_timer_ints() - avoided;
+    kprintf("Avoided %d of %d timer interrupts\n",
+            avoided, 2000 / TICK_LENGTH_IN_MS);
+    ASSERT(avoided >= 2000 / TICK_LENGTH_IN_MS / 2);
+
+    // the idle proc is still charged for the time
+    ASSERT(sysgetcputimes(&ps, 0) >= 1);
+    ASSERT_EQUAL(ps.pid[0], 0);
+    ASSERT(ps.cpuTime[0] >= 2000);
+
+    sysputs("Done test_tickless_idle\n");
+}
+
+/**
+ * Tests the clock never runs backwards, and agrees with syssleep
+ */
+static void test_gettime_ns(void) {
+    unsigned long long before;
+    unsigned long long after;
+
+    ASSERT_EQUAL(sysgettime_ns(NULL), SYSERR_OTHER);
+
+    ASSERT_EQUAL(sysgettime_ns(&before), 0);
+    ASSERT_EQUAL(sysgettime_ns(&after), 0);
+    ASSERT(after >= before);
+
+    ASSERT_EQUAL(syssleep(100), 0);
+    ASSERT_EQUAL(sysgettime_ns(&after), 0);
+    ASSERT(after - before >= 100 * 1000000ULL);
+
+    sysputs("Done test_gettime_ns\n");
+}
+
+/**
+ * Tests syssleep_us sleeps at least as long as asked,
+ * and a sleep shorter than a tick is not rounded up to one
+ */
+static void test_sleep_us(void) {
+    unsigned int times[] = {1, 300, 2500, 10000, 37000};
+    unsigned long long before;
+    unsigned long long after;
+
+    for (int i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        ASSERT_EQUAL(sysgettime_ns(&before), 0);
+        ASSERT_EQUAL(syssleep_us(times[i]), 0);
+        ASSERT_EQUAL(sysgettime_ns(&after), 0);
+
+        // well under 4 seconds, so the nanoseconds fit in 32 bits
+        unsigned long elapsed_us = (unsigned long)(after - before) / 1000;
+        kprintf("syssleep_us(%d) took %d us\n", times[i], elapsed_us);
+        ASSERT(elapsed_us >= times[i]);
+        ASSERT(elapsed_us < times[i] + TICK_LENGTH_IN_MS * 1000);
+    }
+
+    ASSERT_EQUAL(syssleep_us(0), 0);
+    sysputs("Done test_sleep_us\n");
+}
+
+// pid of test_cputime_breakdown, for its helper to report back to
+static int g_breakdown_parent;
+
+/**
+ * Tests a proc which always blocks before the timer fires is still charged
+ * for the time it runs, and that its time adds up
+ */
+static void test_cputime_breakdown(void) {
+    processStatuses ps;
+    g_breakdown_parent = sysgetpid();
+    int pid = syscreate(&blocks_before_ticks, DEFAULT_STACK_SIZE);
+    ASSERT(pid > 0);
+
+    // it sends once it's done, then waits to be released
+    unsigned long num;
+    ASSERT_EQUAL(sysrecv(&pid, &num), 0);
+
+    int num_procs = sysgetcputimes(&ps, 0);
+    int i = 0;
+    while (i < num_procs && ps.pid[i] != pid) {
+        i++;
+    }
+    ASSERT(i < num_procs);
+
+    kprintf("pid %d: %d ms total, %d user, %d kernel, %d interrupt\n",
+            pid, ps.cpuTime[i], ps.userTime[i], ps.kernelTime[i],
+            ps.intrTime[i]);
+
+    // it spun for 3ms at a time, 20 times
+    ASSERT(ps.userTime[i] >= 50);
+
+    // each is rounded down on its own
+    long sum = ps.userTime[i] + ps.kernelTime[i] + ps.intrTime[i];
+    ASSERT(sum <= ps.cpuTime[i] && ps.cpuTime[i] <= sum + 2);
+
+    ASSERT_EQUAL(syssend(pid, 0), 0);
+    sysputs("Done test_cputime_breakdown\n");
+}
+
+/**
+ * Helper for test_cputime_breakdown. Spins for a fraction of a tick, then
+ * sleeps, so the timer rarely fires while it runs.
+ */
+static void blocks_before_ticks(void) {
+    for (int i = 0; i < 20; i++) {
+        unsigned long long start;
+        unsigned long long now;
+        ASSERT_EQUAL(sysgettime_ns(&start), 0);
+
+        do {
+            for (volatile int spin = 0; spin < 10000; spin++);
+            ASSERT_EQUAL(sysgettime_ns(&now), 0);
+        } while (now - start < 3 * 1000000ULL);
+
+        syssleep_us(TICK_LENGTH_IN_MS * 1000 - 3000);
+    }
+
+    unsigned long num;
+    ASSERT_EQUAL(syssend(g_breakdown_parent, 0), 0);
+    ASSERT_EQUAL(sysrecv(&g_breakdown_parent, &num), 0);
+}
+
 /* These are all for the sleep tests, to call syssleep() for a preset time */
 static void sleep5(void) {
     ASSERT_EQUAL(syssleep(5000), 0);
@@ -309,16 +450,22 @@ static void test_sysgetcputimes(void) {
     sysyield();
 
     // invalid addresses
-    ASSERT_EQUAL(sysgetcputimes((processStatuses*)-8), -1);
-    ASSERT_EQUAL(sysgetcputimes((processStatuses*)0xFFFFFFFF), -1);
+    ASSERT_EQUAL(sysgetcputimes((processStatuses*)-8, 0), -1);
+    ASSERT_EQUAL(sysgetcputimes((processStatuses*)0xFFFFFFFF, 0), -1);
 
     // falls within hole
-    ASSERT_EQUAL(sysgetcputimes((processStatuses*)HOLESTART), -1);
+    ASSERT_EQUAL(sysgetcputimes((processStatuses*)HOLESTART, 0), -1);
 
     processStatuses ps;
 
-    int num_procs_before = sysgetcputimes(&ps);
-    ASSERT(num_procs_before > 0 && num_procs_before < 32);
+    // invalid cursors
+    ASSERT_EQUAL(sysgetcputimes(&ps, -1), -1);
+    ASSERT_EQUAL(sysgetcputimes(&ps, PCB_MAX_PROCS + 1), -1);
+
+    // few enough procs to fit in one batch
+    int num_procs_before = sysgetcputimes(&ps, 0);
+    ASSERT(num_procs_before > 1 && num_procs_before < PS_BATCH_SIZE);
+    ASSERT_EQUAL(ps.nextCursor, 0);
     kprintf("num_procs_before in sysgetcputimes: %d\n", num_procs_before);
 
     int proc_pid_1 = syscreate(&cputimehelper, DEFAULT_STACK_SIZE);
@@ -337,7 +484,7 @@ static void test_sysgetcputimes(void) {
     // call sysyield so created procs can run
     sysyield();
 
-    int num_procs_after = sysgetcputimes(&ps);
+    int num_procs_after = sysgetcputimes(&ps, 0);
 
     // check procs are added, stopped processes aren't
     ASSERT_EQUAL(num_procs_before + 2, num_procs_after);
@@ -354,7 +501,7 @@ static void test_sysgetcputimes(void) {
 
     int hit_1 = 0;
     int hit_2 = 0;
-    for (int i = 2; i <= num_procs_after; i++) {
+    for (int i = 2; i < num_procs_after; i++) {
         if (!hit_1 && ps.pid[i] == proc_pid_1) {
             hit_1 = 1;
             ASSERT(ps.cpuTime[i] >= 1);
@@ -15,6 +15,7 @@ static void command_k(void);
 static void command_a(void);
 static void command_t(void);
 static void command_sudo(void);
+static void command_stat(void);
 
 static int g_pid_to_kill;
 
@@ -27,7 +28,53 @@ static char *detailed_states[] = {
     "BLOCKED: WAITING",
     "BLOCKED: RECEIVE ANY",
     "BLOCKED: SLEEPING",
-    "BLOCKED: IO"
+    "BLOCKED: IO",
+    "BLOCKED: MAILBOX",
+    "BLOCKED: SIGWAIT"
+};
+
+// one name per status fill_proc_info can report, see pcb.c
+_Static_assert(sizeof(detailed_states) / sizeof(detailed_states[0]) ==
+               PROC_STATE_BLOCKED + NO_BLOCKER,
+               "detailed_states needs a name for every blocking_queue_t");
+
+// indexed by syscall_request_id_t
+static char *request_names[] = {
+    "timer int",
+    "keyboard int",
+    "create",
+    "yield",
+    "stop",
+    "getpid",
+    "kill",
+    "wait",
+    "puts",
+    "send",
+    "recv",
+    "sleep",
+    "cputimes",
+    "sighandler",
+    "sigreturn",
+    "open",
+    "close",
+    "write",
+    "read",
+    "ioctl",
+    "setprio",
+    "getprio",
+    "post",
+    "mbox_recv",
+    "ring_register",
+    "ring_submit",
+    "stat",
+    "gettime_ns",
+    "sleep_us",
+    "setquantum",
+    "sigmask",
+    "sigqueue",
+    "sigwait",
+    "readv",
+    "writev"
 };
 
 static char *g_arg;
@@ -88,6 +135,10 @@ static void filter_newline(char *str) {
  */
 static void shell(void) {
     setup_kill_handler();
+
+    // the shell is interactive, so it should never wait behind commands
+    syssetprio(0, PROC_PRIORITY_HIGHEST);
+
     sysputs("\n");
     int fd = sysopen(DEVICE_ID_KEYBOARD);
 
@@ -127,6 +178,10 @@ static void shell(void) {
             g_pid_to_kill = atoi(arg);
             pid = syscreate(&command_k, DEFAULT_STACK_SIZE);
 
+        } else if(!strcmp("stat", command)) {
+            g_arg = arg;
+            pid = syscreate(&command_stat, DEFAULT_STACK_SIZE);
+
         } else if(!strcmp("ex", command)) {           
             break;
 
@@ -213,14 +268,67 @@ static void command_ps(void) {
     setup_kill_handler();
     processStatuses ps;
     char str[80];
+    int cursor = 0;
 
-    int num = sysgetcputimes(&ps);
+    sysputs("PID | State           | Time     | User     | Kernel | Intr   "
+            "| Prio\n");
+    do {
+        int num = sysgetcputimes(&ps, cursor);
+        if (num < 0) {
+            break;
+        }
+        for (int i = 0; i < num; i++) {
+            sprintf(str, "%4d  %16s  %8d  %8d  %6d  %6d  %4d\n", ps.pid[i],
+                    detailed_states[ps.status[i]], ps.cpuTime[i],
+                    ps.userTime[i], ps.kernelTime[i], ps.intrTime[i],
+                    ps.priority[i]);
+            sysputs(str);
+        }
+
+        cursor = ps.nextCursor;
+    } while (cursor != 0);
+}
 
-    sysputs("PID | State           | Time\n");
-    for (int i = 0; i <= num; i++) {
-        sprintf(str, "%4d  %16s  %8d\n", ps.pid[i],
-                detailed_states[ps.status[i]], ps.cpuTime[i]);
+/**
+ * Prints how often each request was handled, and how long it took in cycles.
+ * Requests which were never handled are skipped.
+ * If g_arg is "reset", the kernel's counts are cleared after printing.
+ */
+static void command_stat(void) {
+    setup_kill_handler();
+    syscallStats stats;
+    char str[80];
+
+    int num = sysstat(&stats, !strcmp("reset", g_arg));
+
+    sysputs("Request       | Count    | Min      | Avg      | Max\n");
+    for (int i = 0; i < num; i++) {
+        if (stats.count[i] == 0) {
+            continue;
+        }
+
+        sprintf(str, "%13s  %9u  %9u  %9u  %9u\n", request_names[i],
+                stats.count[i], stats.minCycles[i], stats.avgCycles[i],
+                stats.maxCycles[i]);
         sysputs(str);
+
+        // the latency histogram, one "<2^n:count" per bucket in use
+        sysputs("              ");
+        for (int b = 0; b < SYSSTAT_HIST_BUCKETS; b++) {
+            if (stats.histogram[i][b] == 0) {
+                continue;
+            }
+
+            if (b == SYSSTAT_HIST_BUCKETS - 1) {
+                sprintf(str, " >=2^%d:%u", b + SYSSTAT_HIST_MIN_LOG2,
+                        stats.histogram[i][b]);
+            } else {
+                sprintf(str, " <2^%d:%u", b + SYSSTAT_HIST_MIN_LOG2 + 1,
+                        stats.histogram[i][b]);
+            }
+            sysputs(str);
+        }
+        sysputs("\n");
     }
 }
 
@@ -0,0 +1,30 @@
+/* bitops.h : bit scans over a word, with the i386 bsf and bsr instructions
+   Used for the ready level bitmap, signal sets, the sleep wheel, and TLSF
+ */
+
+#ifndef BITOPS_H
+#define BITOPS_H
+
+/**
+ * Returns the index of the lowest set bit. word must not be 0.
+ * @param word - the word to scan
+ * @return index of the lowest set bit
+ */
+static inline int bit_scan_forward(unsigned int word) {
+    int bit;
+    __asm__("bsfl %1, %0" : "=r" (bit) : "rm" (word));
+    return bit;
+}
+
+/**
+ * Returns the index of the highest set bit. word must not be 0.
+ * @param word - the word to scan
+ * @return index of the highest set bit
+ */
+static inline int bit_scan_reverse(unsigned int word) {
+    int bit;
+    __asm__("bsrl %1, %0" : "=r" (bit) : "rm" (word));
+    return bit;
+}
+
+#endif
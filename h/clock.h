@@ -0,0 +1,26 @@
+/* clock.h : clocksource, the TSC calibrated against the PIT
+   See clock.c for further documentation
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <xeroskernel.h>
+
+void clock_init(void);
+void clock_set_khz(unsigned long khz);
+unsigned long clock_get_khz(void);
+
+unsigned long long clock_ns(void);
+
+unsigned long long clock_cycles_to_ns(unsigned long long cycles);
+unsigned long long clock_cycles_to_us(unsigned long long cycles);
+unsigned long long clock_cycles_to_ms(unsigned long long cycles);
+unsigned long clock_cycles_to_ticks(unsigned long long cycles);
+unsigned int clock_cycles_to_pit(unsigned long long cycles);
+unsigned long long clock_us_to_cycles(unsigned int us);
+
+void clock_mark_tick(void);
+unsigned long long clock_next_tick(void);
+
+#endif
@@ -0,0 +1,17 @@
+/* cons.h : console device
+   See cons.c for further documentation
+ */
+
+#include <xeroskernel.h>
+
+void cons_devsw_create(devsw_t *entry);
+int cons_init(void);
+int cons_open(proc_ctrl_block_t *proc, void *dvioblk);
+int cons_close(proc_ctrl_block_t *proc, void *dvioblk);
+int cons_read(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen);
+int cons_write(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen);
+int cons_writev(proc_ctrl_block_t *proc, void *dvioblk,
+                const iovec_t *iov, int iovcnt);
+int cons_ioctl(proc_ctrl_block_t *proc, void *dvioblk, unsigned long command, void *args);
+int cons_iint(void);
+int cons_oint(void);
@@ -77,6 +77,17 @@ struct segtr {
 #define HOLEEND         ((1024 + HOLESIZE) * 1024)
 /* Extra 600 for bootp loading, and monitor */
 
+/* Usable physical memory, as found by sizmem() (set in i386.c) */
+#define	MAX_MEM_REGIONS	16
+
+struct memregion {
+	unsigned long	mr_start;	/* first address of the region	*/
+	unsigned long	mr_end;		/* first address past its end	*/
+};
+
+extern struct memregion	memregions[];
+extern int		nmemregions;
+
 /* Code grokked from cs452 (waterloo) libs
  */
 #define TIMER_IRQ	0	/* IRQ of counter 0 on timer 1 */
@@ -116,5 +127,10 @@ void setEnabledKbd( int enable );
 
 /* Some helpful prototypes */
 void initPIT( int divisor );
+int oneshotPIT( int ticks );
+int oneshotElapsedPIT( void );
+void oneshotCountPIT( unsigned int count );
+unsigned int readPIT( void );
 void end_of_intr( void );
+unsigned long long rdtsc( void );
 
@@ -10,8 +10,11 @@ int kbd_init(void);
 int kbd_open(proc_ctrl_block_t *proc, void *dvioblk);
 int kbd_close(proc_ctrl_block_t *proc, void *dvioblk);
 int kbd_read(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen);
+int kbd_readv(proc_ctrl_block_t *proc, void *dvioblk,
+              const iovec_t *iov, int iovcnt);
 int kbd_write(proc_ctrl_block_t *proc, void *dvioblk, void* buf, int buflen);
 int kbd_ioctl(proc_ctrl_block_t *proc, void *dvioblk, unsigned long command, void *args);
+void kbd_cancel(proc_ctrl_block_t *proc, void *dvioblk);
 int kbd_iint(void);
 int kbd_oint(void);
 
@@ -8,10 +8,30 @@
 #define SIGNAL_TABLE_SIZE 32
 #define SIGNAL_DNE -2
 
+// nonzero to run every pending signal's handler in one trip into the
+// process, see deliver_signals, may be set at build time
+#ifndef SIGNAL_BATCH
+#define SIGNAL_BATCH 1
+#endif
+
+// signal instances a proc may have queued by syssigqueue at once
+#define SIGNAL_QUEUE_SIZE 32
+
+// one READY queue per priority level, then the STOPPED queue
+#define NUM_G_PROC_QUEUES (PROC_NUM_PRIORITIES + 1)
+#define STOPPED_QUEUE PROC_NUM_PRIORITIES
+
+// what a proc's cpu time was spent on, see charge_proc_cycles
+typedef enum {
+    CPU_TIME_USER = 0,
+    CPU_TIME_KERNEL,
+    CPU_TIME_INTR
+} cpu_time_kind_t;
+
 // Kernel PCB structures defined in pcb.c
-extern proc_ctrl_block_t g_pcb_table[PCB_TABLE_SIZE];
-extern proc_ctrl_block_t *g_proc_queue_heads[2];
-extern proc_ctrl_block_t *g_proc_queue_tails[2];
+extern proc_ctrl_block_t g_pcb_table[PCB_CHUNK_SIZE];
+extern proc_ctrl_block_t *g_proc_queue_heads[NUM_G_PROC_QUEUES];
+extern proc_ctrl_block_t *g_proc_queue_tails[NUM_G_PROC_QUEUES];
 
 void pcb_table_init(void);
 
@@ -20,6 +40,7 @@ proc_ctrl_block_t* get_next_available_pcb(void);
 
 void add_pcb_to_queue(proc_ctrl_block_t *proc, proc_state_enum_t new_state);
 void remove_pcb_from_queue(proc_ctrl_block_t *proc);
+proc_ctrl_block_t* get_pcb_queue_head(proc_state_enum_t queue);
 void print_pcb_queue(proc_state_enum_t queue);
 
 void add_proc_to_blocking_queue(proc_ctrl_block_t *proc,
@@ -33,9 +54,26 @@ int remove_proc_from_blocking_queue(proc_ctrl_block_t *proc,
 proc_ctrl_block_t* pid_to_proc(int pid);
 proc_ctrl_block_t* get_idleproc(void);
 
-int get_all_proc_info(processStatuses *ps);
+void charge_proc_tick(proc_ctrl_block_t *proc);
+void charge_proc_cycles(proc_ctrl_block_t *proc, cpu_time_kind_t kind,
+                        unsigned long long cycles);
+int set_proc_priority(proc_ctrl_block_t *proc, int priority);
+int set_proc_quantum(proc_ctrl_block_t *proc, int ticks);
+int quantum_expired(proc_ctrl_block_t *proc);
+int ready_proc_waiting(proc_ctrl_block_t *proc);
+int higher_priority_ready(proc_ctrl_block_t *proc);
+
+int get_all_proc_info(processStatuses *ps, int cursor);
 int set_proc_signal(proc_ctrl_block_t *proc, int signal);
-void call_highest_priority_signal(proc_ctrl_block_t *proc);
+int queue_proc_signal(proc_ctrl_block_t *proc, int signal,
+                      unsigned long value);
+int take_proc_signal(proc_ctrl_block_t *proc, int signal,
+                     unsigned long *value);
+int take_highest_signal(proc_ctrl_block_t *proc, unsigned int set,
+                        unsigned long *value);
+unsigned int deliverable_signals(proc_ctrl_block_t *proc);
+void deliver_signals(proc_ctrl_block_t *proc);
+void deliver_signals_as(proc_ctrl_block_t *proc, int batch);
 
 void cleanup_proc(proc_ctrl_block_t *proc);
 
@@ -48,6 +48,8 @@ unsigned short getCS(void);
 unsigned char  inb(unsigned int);
 void           init8259(void);
 int            kprintf(char * fmt, ...);
+void           kconsole_write(const char *buf, int len);
+void           kconsole_cursor(void);
 void           lidt(void);
 void           outb(unsigned int, unsigned char);
 void           set_evec(unsigned int xnum, unsigned long handler);
@@ -66,8 +68,35 @@ void           set_evec(unsigned int xnum, unsigned long handler);
 #else
 #define DEBUG(...)
 #endif
+
+/* Invariant checking, CHECK_LEVEL is set by compile/Makefile:
+ *   CHECK_NONE  - ASSERTs compile away
+ *   CHECK_CHEAP - ASSERTs are checked
+ *   CHECK_FULL  - whole structures are also walked after every change,
+ *                 e.g. the pcb queues on every scheduling operation
+ * Tests report failures through ASSERT, so TESTING keeps them.
+ */
+#define CHECK_NONE 0
+#define CHECK_CHEAP 1
+#define CHECK_FULL 2
+
+#ifndef CHECK_LEVEL
+#define CHECK_LEVEL CHECK_FULL
+#endif
+
+#if defined(TESTING) && CHECK_LEVEL < CHECK_CHEAP
+#undef CHECK_LEVEL
+#define CHECK_LEVEL CHECK_CHEAP
+#endif
+
+#if CHECK_LEVEL >= CHECK_CHEAP
 #define ASSERT(x) if (!(x)) { DEBUG("Assertion failed!"); while(1); }
 #define ASSERT_EQUAL(x, y) if (x != y) { DEBUG("Assertion failed. %d != %d", x, y); while(1); }
+#else
+// the checks go, but the expressions are still evaluated for side effects
+#define ASSERT(x) (void)(x)
+#define ASSERT_EQUAL(x, y) (void)((x) != (y))
+#endif
 
 typedef void (*funcptr)(void);
 typedef void (*funcptr_args1)(void*);
@@ -80,6 +109,21 @@ void* kmalloc(size_t size);
 void  kfree(void *ptr);
 void  kmem_dump_free_list(void);
 int kmem_get_free_list_length(void);
+int kmem_get_num_regions(void);
+void  kmem_get_free_stats(size_t *total, size_t *largest);
+
+/* Slab allocator, for small fixed size objects */
+void  kslab_init(void);
+void* kslab_alloc(size_t size);
+void  kslab_free(void *ptr);
+void  kslab_dump_stats(void);
+int   kslab_get_in_use(size_t size);
+
+void  stackpool_init(void);
+void* stackpool_alloc(size_t size);
+void  stackpool_free(void *ptr);
+void  stackpool_dump_stats(void);
+void  stackpool_get_stats(unsigned int *hits, unsigned int *misses);
 
 /* Forward declarations */
 typedef struct proc_ctrl_block proc_ctrl_block_t;
@@ -88,6 +132,7 @@ typedef struct proc_ctrl_block proc_ctrl_block_t;
 typedef enum device_id_enum {
     DEVICE_ID_KEYBOARD_NO_ECHO = 0,
     DEVICE_ID_KEYBOARD,
+    DEVICE_ID_CONSOLE,
     NUM_DEVICES_ID_ENUMS
 } device_id_enum_t;
 
@@ -100,6 +145,25 @@ typedef enum device_id_enum {
 // These aren't required by asst3, but we've implemented them for testing
 #define KEYBOARD_IOCTL_GET_EOF 57
 #define KEYBOARD_IOCTL_GET_ECHO 58
+// resize the buffer of typed characters, read its size, and read how many
+// characters were dropped because it was full
+#define KEYBOARD_IOCTL_SET_BUFFER_SIZE 59
+#define KEYBOARD_IOCTL_GET_BUFFER_SIZE 60
+#define KEYBOARD_IOCTL_GET_DROPPED 61
+
+// sizes of the buffer of typed characters, which must be a power of two
+#define KBD_BUFFER_SIZE_DEFAULT 128
+#define KBD_BUFFER_SIZE_MIN 16
+#define KBD_BUFFER_SIZE_MAX 4096
+
+// one buffer of a sysreadv or syswritev, which take up to IOV_MAX of them
+typedef struct iovec {
+    void *iov_base;
+    int iov_len;
+} iovec_t;
+#define IOV_MAX 16
+// the most bytes one sysreadv or syswritev may move, so the count fits an int
+#define IOV_BYTES_MAX 0x7fffffff
 
 typedef struct devsw {
     int dvnum;
@@ -110,6 +174,12 @@ typedef struct devsw {
     int (*dvread)(proc_ctrl_block_t *proc, void *dvioblk, void *buf, int buflen);
     int (*dvwrite)(proc_ctrl_block_t *proc, void *dvioblk, void *buf, int buflen);
     int (*dvioctl)(proc_ctrl_block_t *proc, void *dvioblk, unsigned long command, void *args);
+    // read into or write from several buffers at once, NULL to have
+    // di_readv and di_writev call dvread or dvwrite once per buffer
+    int (*dvreadv)(proc_ctrl_block_t *proc, void *dvioblk, const iovec_t *iov, int iovcnt);
+    int (*dvwritev)(proc_ctrl_block_t *proc, void *dvioblk, const iovec_t *iov, int iovcnt);
+    // abandons a read proc is blocked on, NULL if reads never block
+    void (*dvcancel)(proc_ctrl_block_t *proc, void *dvioblk);
     // input available interrupt
     int (*dviint)(void);
     // output available interrupt
@@ -123,10 +193,29 @@ void di_init_devtable(void);
 
 /* Process Manager */
 
-// maximum number of processes
-#define PCB_TABLE_SIZE 32
+// pcbs are allocated PCB_CHUNK_SIZE at a time, up to PCB_MAX_PROCS
+#define PCB_CHUNK_SIZE 32
+#define PCB_MAX_CHUNKS 128
+#define PCB_MAX_PROCS (PCB_CHUNK_SIZE * PCB_MAX_CHUNKS)
 #define PCB_NUM_FDS 4
 
+// scheduling priorities, a lower number is scheduled first
+#define PROC_NUM_PRIORITIES 8
+#define PROC_PRIORITY_HIGHEST 0
+#define PROC_PRIORITY_LOWEST (PROC_NUM_PRIORITIES - 1)
+
+// ticks a proc may run before others of its priority get a turn,
+// the default may be set at build time
+#ifndef PROC_QUANTUM_DEFAULT
+#define PROC_QUANTUM_DEFAULT 1
+#endif
+#define PROC_QUANTUM_MAX 100
+#define PROC_PRIORITY_DEFAULT 2
+
+// mailboxes hold up to MBOX_CAPACITY messages of up to MBOX_MSG_SIZE bytes
+#define MBOX_CAPACITY 16
+#define MBOX_MSG_SIZE 64
+
 typedef enum {
     PROC_STATE_READY = 0,
     PROC_STATE_STOPPED = 1,
@@ -141,6 +230,8 @@ typedef enum {
     RECEIVE_ANY,
     SLEEP,
     DEVICE,
+    MAILBOX,
+    SIGWAIT,
     NO_BLOCKER
 } blocking_queue_t;
 
@@ -149,16 +240,41 @@ typedef struct proc_ctrl_block {
     proc_state_enum_t curr_state;
     struct proc_ctrl_block *next_proc;
     struct proc_ctrl_block *prev_proc;
-    int cpu_time;
+    // TSC cycles spent running user code, in the kernel handling its
+    // syscalls, and in the kernel handling interrupts that landed on it
+    unsigned long long user_cycles;
+    unsigned long long kernel_cycles;
+    unsigned long long intr_cycles;
+
+    // current ready queue level, and the level boosts return it to
+    int priority;
+    int base_priority;
+    // ticks of cpu time used since arriving at the current level
+    int level_ticks;
+    // ticks it may run per dispatch, and ticks left of the current one
+    int quantum;
+    int quantum_left;
 
     void *memory_region;
     void *esp;
     unsigned long *args;
     int ret;
 
+    // timer wheel slot holding this proc while it sleeps, and the TSC
+    // value a sleep_us ends at, 0 for sleep, see sleep.c
+    int sleep_slot;
+    unsigned long long sleep_deadline;
+
     funcptr_args1 *signal_table;
+    // signals sent by syskill, which collapse into one delivery each,
+    // and signals with instances in signal_queue, sent by syssigqueue
     int signals_fired;
+    unsigned int signals_queued;
+    // signals held back from handlers, they stay pending for syssigwait
+    unsigned int signals_masked;
     int signals_enabled;
+    // allocated on the first syssigqueue, see pcb.c
+    struct signal_queue *signal_queue;
     
     devsw_t *fd_table[PCB_NUM_FDS];
 
@@ -166,6 +282,12 @@ typedef struct proc_ctrl_block {
     blocking_queue_t blocking_queue_name;
     struct proc_ctrl_block *blocking_queue_heads[3];
     struct proc_ctrl_block *blocking_queue_tails[3];
+
+    // messages posted to this proc, allocated on the first post
+    struct mailbox *mailbox;
+
+    // batched syscall ring registered by this proc, in its own memory
+    struct syscall_ring *syscall_ring;
 } proc_ctrl_block_t;
 
 
@@ -194,11 +316,30 @@ typedef enum {
     SYSCALL_CLOSE,
     SYSCALL_WRITE,
     SYSCALL_READ,
-    SYSCALL_IOCTL
+    SYSCALL_IOCTL,
+    SYSCALL_SETPRIO,
+    SYSCALL_GETPRIO,
+    SYSCALL_POST,
+    SYSCALL_MBOX_RECV,
+    SYSCALL_RING_REGISTER,
+    SYSCALL_RING_SUBMIT,
+    SYSCALL_STAT,
+    SYSCALL_GETTIME_NS,
+    SYSCALL_SLEEP_US,
+    SYSCALL_SETQUANTUM,
+    SYSCALL_SIGMASK,
+    SYSCALL_SIGQUEUE,
+    SYSCALL_SIGWAIT,
+    SYSCALL_READV,
+    SYSCALL_WRITEV,
+
+    // number of request ids, must be last
+    NUM_REQUEST_IDS
 } syscall_request_id_t;
 
 void dispinit(void);
 void dispatch(funcptr root_proc);
+unsigned int get_avoided_timer_ints(void);
 
 /* syscall return constants */
 #define SYSPID_OK       0
@@ -210,19 +351,68 @@ void dispatch(funcptr root_proc);
 #define SYSWAIT_SIGNALLED -2
 #define SYSHANDLER_INVALID_SIGNAL -1
 #define SYSHANDLER_INVALID_FUNCPTR -2
+#define SYSPRIO_INVALID_PRIORITY -2
+#define SYSQUANTUM_INVALID -2
+#define SYSMBOX_FULL -4
+#define SYSSIGQUEUE_FULL -5
 #define PROC_SIGNALLED -362
 
 /* ctsw */
 void ctsw_init_evec(void);
 syscall_request_id_t ctsw_contextswitch(proc_ctrl_block_t *proc);
+unsigned int ctsw_get_fast_yields(void);
 
 /* syscall */
+// procs per sysgetcputimes call, see sysgetcputimes for enumerating them all
+#define PS_BATCH_SIZE 32
+
 typedef struct struct_ps {
-  int pid[PCB_TABLE_SIZE];
-  int status[PCB_TABLE_SIZE];
-  long cpuTime[PCB_TABLE_SIZE];
+  int pid[PS_BATCH_SIZE];
+  int status[PS_BATCH_SIZE];
+  // milliseconds, cpuTime is the total of the three after it
+  long cpuTime[PS_BATCH_SIZE];
+  long userTime[PS_BATCH_SIZE];
+  long kernelTime[PS_BATCH_SIZE];
+  long intrTime[PS_BATCH_SIZE];
+  int priority[PS_BATCH_SIZE];
+  // cursor for the next batch, 0 once every proc has been returned
+  int nextCursor;
 } processStatuses;
 
+// latencies are also counted in power of two buckets. Bucket b counts
+// latencies from 2^(b + SYSSTAT_HIST_MIN_LOG2) up to twice that; the first
+// bucket also counts anything shorter, and the last anything longer.
+#define SYSSTAT_HIST_BUCKETS 16
+#define SYSSTAT_HIST_MIN_LOG2 6
+
+// indexed by syscall_request_id_t, latencies are in cpu cycles
+typedef struct struct_stats {
+  unsigned long count[NUM_REQUEST_IDS];
+  unsigned long minCycles[NUM_REQUEST_IDS];
+  unsigned long avgCycles[NUM_REQUEST_IDS];
+  unsigned long maxCycles[NUM_REQUEST_IDS];
+  unsigned long histogram[NUM_REQUEST_IDS][SYSSTAT_HIST_BUCKETS];
+} syscallStats;
+
+/* batched syscalls, see sysring_register */
+#define SYSCALL_RING_SIZE 16
+#define SYSCALL_RING_MAX_ARGS 3
+
+typedef struct syscall_ring_entry {
+  syscall_request_id_t request;
+  unsigned long args[SYSCALL_RING_MAX_ARGS];
+  int ret;
+} syscall_ring_entry_t;
+
+typedef struct syscall_ring {
+  // entries are filled at tail by the process, and run from head by the kernel
+  unsigned int head;
+  unsigned int tail;
+  // entry whose syscall blocked the process, -1 if none
+  int blocked;
+  syscall_ring_entry_t entries[SYSCALL_RING_SIZE];
+} syscall_ring_t;
+
 extern unsigned int syscreate(funcptr func, int stack);
 extern void sysyield(void);
 extern void sysstop(void);
@@ -235,7 +425,7 @@ extern int sysrecvbuf(int *from_pid, void *buffer, unsigned long len);
 extern int syssend(int dest_pid, unsigned long num);
 extern int sysrecv(int *from_pid, unsigned long *num);
 extern unsigned int syssleep(unsigned int milliseconds);
-extern int sysgetcputimes(processStatuses *ps);
+extern int sysgetcputimes(processStatuses *ps, int cursor);
 extern int syssighandler(int signal, funcptr_args1 newhandler,
                          funcptr_args1 *oldHandler);
 extern void syssigreturn(void *old_sp);
@@ -244,6 +434,24 @@ extern int sysclose(int fd);
 extern int syswrite(int fd, void *buf, int buflen);
 extern int sysread(int fd, void *buf, int buflen);
 extern int sysioctl(int fd, unsigned long command, ...);
+extern int syssetprio(int pid, int priority);
+extern int sysgetprio(int pid);
+extern int syspost(int dest_pid, void *buffer, unsigned long len);
+extern int sysmbox_recv(int *from_pid, void *buffer, unsigned long len);
+extern int sysring_register(syscall_ring_t *ring);
+extern int sysring_prep(syscall_ring_t *ring, syscall_request_id_t request,
+                        unsigned long arg1, unsigned long arg2,
+                        unsigned long arg3);
+extern int sysring_submit(syscall_ring_t *ring);
+extern int sysstat(syscallStats *stats, int reset);
+extern int sysgettime_ns(unsigned long long *ns);
+extern unsigned int syssleep_us(unsigned int microseconds);
+extern int syssetquantum(int pid, int ticks);
+extern int syssigmask(unsigned int mask, unsigned int *old_mask);
+extern int syssigqueue(int pid, int signal, unsigned long value);
+extern int syssigwait(unsigned int set, unsigned long *value);
+extern int sysreadv(int fd, const iovec_t *iov, int iovcnt);
+extern int syswritev(int fd, const iovec_t *iov, int iovcnt);
 
 typedef struct context_frame {
     unsigned long edi;
@@ -273,6 +481,11 @@ extern int di_write(proc_ctrl_block_t *proc, int fd, void *buf, int buflen);
 extern int di_read(proc_ctrl_block_t *proc, int fd, void *buf, int buflen);
 extern int di_ioctl(proc_ctrl_block_t *proc, int fd,
                     unsigned long command_code, void *args);
+extern int di_readv(proc_ctrl_block_t *proc, int fd,
+                    const iovec_t *iov, int iovcnt);
+extern int di_writev(proc_ctrl_block_t *proc, int fd,
+                     const iovec_t *iov, int iovcnt);
+extern void di_cancel_read(proc_ctrl_block_t *proc);
 
 /* kernel services */
 extern void init_idle_proc(proc_ctrl_block_t *idle_proc);
@@ -289,12 +502,28 @@ extern int recv(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
 extern int recv_any(proc_ctrl_block_t *destproc,
                     void *buffer, unsigned long len);
 
+extern int post(proc_ctrl_block_t *srcproc, proc_ctrl_block_t *destproc,
+                void *buffer, unsigned long len);
+
+extern int mbox_recv(proc_ctrl_block_t *proc, int *from_pid,
+                     void *buffer, unsigned long len);
+
+extern void mbox_free(proc_ctrl_block_t *proc);
+
+extern void sleep_init(void);
 extern void sleep(proc_ctrl_block_t *proc, unsigned int time);
+extern void sleep_us(proc_ctrl_block_t *proc, unsigned int time);
 extern void wake(proc_ctrl_block_t *proc);
 extern void tick(void);
+extern void advance_ticks(unsigned int ticks);
+extern int ticks_until_wake(void);
+extern void expire_short_sleepers(void);
+extern int next_short_deadline(unsigned long long *deadline);
 
 extern void sigtramp(funcptr_args1 handler, void *cntx);
+extern void sigtramp_batch(funcptr_args1 *handlers, int count, void *cntx);
 extern int signal(int pid, int sig_no);
+extern int signal_batch(int pid, unsigned int signals);
 
 /* user programs */
 extern void login_proc(void);
@@ -3,7 +3,7 @@
 #ifndef XEROSTEST_H
 #define XEROSTEST_H
 
-#define BUSYWAIT() for (int i = 0; i < 2000000 * 5; i++);
+#define BUSYWAIT() for (volatile int i = 0; i < 2000000 * 5; i++);
 
 // Hacky cleanup: yield a bunch of times so that all testfuncs have
 #define MASS_SYSYIELD() for (int i = 0; i < 100; i++) sysyield();